@@ -0,0 +1,269 @@
+#ifndef ARCFLAGS_H
+#define ARCFLAGS_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           ArcFlags
+//  Description:    Goal directed pruning for an IndexedGraph. The map
+//                  is cut into a grid of regions over the node
+//                  positions, and every arc gets one bit per region,
+//                  set if the arc starts some shortest path into that
+//                  region. A search towards a goal only follows arcs
+//                  whose bit for the goal's region is set, so it
+//                  stays near the shortest paths instead of spreading
+//                  out in every direction the heuristic allows.
+//                  The bits cost (regions + 7) / 8 bytes per arc and
+//                  are worked out once by the constructor. The graph
+//                  must outlive the flags and must not change, since
+//                  the flags are indexed by its arc numbers.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class ArcFlags {
+private:
+	// Follows only the arcs flagged for one region, for
+	// BestFirstSearch.
+	struct FlaggedArcs {
+		ArcFlags const & flags;
+		unsigned int byte;
+		unsigned char bit;
+
+		template<class Relax>
+		bool operator()(NodeId node, Relax& relax) const
+		{
+			IndexedGraph<NodeType, ArcType> const & graph = flags.m_graph;
+			unsigned char const * pFlags = &flags.m_flags[byte];
+			unsigned int bytes = flags.m_bytes;
+			unsigned int end = graph.firstArc(node + 1);
+			for (unsigned int arc = graph.firstArc(node); arc < end; arc++)
+			{
+				if (pFlags[arc * bytes] & bit)
+				{
+					relax(graph.arcTarget(arc), graph.arcWeight(arc));
+				}
+			}
+			return true;
+		}
+	};
+
+	IndexedGraph<NodeType, ArcType> const & m_graph;
+
+	int m_columns;
+	int m_rows;
+	float m_minX;
+	float m_minY;
+	float m_cellWidth;
+	float m_cellHeight;
+
+	// Region of each node, and the flags, arc by arc, m_bytes a piece.
+	std::vector<unsigned int> m_region;
+	std::vector<unsigned char> m_flags;
+	unsigned int m_bytes;
+
+	unsigned int cell(GraphPosition pos) const
+	{
+		int column = std::min(std::max((int)((pos.x - m_minX) / m_cellWidth), 0), m_columns - 1);
+		int row = std::min(std::max((int)((pos.y - m_minY) / m_cellHeight), 0), m_rows - 1);
+		return (unsigned int)(row * m_columns + column);
+	}
+
+	void build(int threads);
+	bool search(NodeId start, NodeId dest, bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const;
+
+public:
+	ArcFlags(IndexedGraph<NodeType, ArcType> const & graph, int columns, int rows, int threads);
+
+	int regionCount() const
+	{
+		return m_columns * m_rows;
+	}
+
+	unsigned int region(NodeId node) const
+	{
+		return m_region[node];
+	}
+
+	bool flag(unsigned int arc, unsigned int region) const
+	{
+		return (m_flags[arc * m_bytes + region / 8] & (1 << (region % 8))) != 0;
+	}
+
+	// Bytes used by the flags and the node regions.
+	size_t flagBytes() const
+	{
+		return m_flags.size() + m_region.size() * sizeof(unsigned int);
+	}
+
+	bool aStar(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(start, dest, true, space, path);
+	}
+
+	bool ucs(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(start, dest, false, space, path);
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           ArcFlags
+//  Description:    Lays the grid over the bounding box of the node
+//                  positions, gives every node its region and works
+//                  out the flags.
+//  Arguments:      The graph, the grid size and the number of
+//                  threads to build with.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+ArcFlags<NodeType, ArcType>::ArcFlags(IndexedGraph<NodeType, ArcType> const & graph, int columns, int rows, int threads)
+	: m_graph(graph), m_columns(std::max(columns, 1)), m_rows(std::max(rows, 1)), m_minX(0), m_minY(0),
+	m_cellWidth(1), m_cellHeight(1), m_region(graph.nodeCount()), m_bytes((regionCount() + 7) / 8)
+{
+	float maxX = 0, maxY = 0;
+	for (NodeId n = 0; n < graph.nodeCount(); n++)
+	{
+		GraphPosition pos = graph.pos(n);
+		if (n == 0 || pos.x < m_minX) m_minX = pos.x;
+		if (n == 0 || pos.y < m_minY) m_minY = pos.y;
+		if (n == 0 || pos.x > maxX) maxX = pos.x;
+		if (n == 0 || pos.y > maxY) maxY = pos.y;
+	}
+	// a little over the box so the far edge falls in the last cell.
+	m_cellWidth = std::max((maxX - m_minX) / m_columns * 1.0001f, 1e-3f);
+	m_cellHeight = std::max((maxY - m_minY) / m_rows * 1.0001f, 1e-3f);
+	for (NodeId n = 0; n < graph.nodeCount(); n++)
+	{
+		m_region[n] = cell(graph.pos(n));
+	}
+	build(threads);
+}
+
+// ----------------------------------------------------------------
+//  Name:           build
+//  Description:    Works out the flags. An arc inside a region is
+//                  flagged for it. A shortest path from outside a
+//                  region last enters it at a boundary node (one with
+//                  an arc in from another region), so for every
+//                  boundary node a uniform cost search over the
+//                  reversed graph finds each node's distance to it,
+//                  and an arc u -> v lies on a shortest path to it
+//                  when dist(u) == weight + dist(v); such arcs get
+//                  the boundary node's region. Ties flag every
+//                  shortest path, never fewer than one.
+//                  The boundary searches are shared out between the
+//                  threads. Each thread sets bits in its own copy of
+//                  the flags, since regions share bytes, and the
+//                  copies are merged at the end.
+//  Arguments:      The number of threads.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void ArcFlags<NodeType, ArcType>::build(int threads)
+{
+	IndexedGraph<NodeType, ArcType> const & graph = m_graph;
+	m_flags.assign(graph.arcCount() * m_bytes, 0);
+
+	std::vector<NodeId> boundary;
+	std::vector<char> isBoundary(graph.nodeCount(), false);
+	for (NodeId from = 0; from < graph.nodeCount(); from++)
+	{
+		for (unsigned int arc = graph.firstArc(from); arc < graph.firstArc(from + 1); arc++)
+		{
+			NodeId to = graph.arcTarget(arc);
+			unsigned int region = m_region[to];
+			if (region == m_region[from])
+			{
+				m_flags[arc * m_bytes + region / 8] |= (unsigned char)(1 << (region % 8));
+			}
+			else if (!isBoundary[to])
+			{
+				isBoundary[to] = true;
+				boundary.push_back(to);
+			}
+		}
+	}
+
+	IndexedGraph<NodeType, ArcType> reverse = graph.reversed();
+	threads = std::max(threads, 1);
+	std::vector<std::vector<unsigned char> > found(threads);
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			std::vector<unsigned char>& flags = found[t];
+			flags.assign(m_flags.size(), 0);
+			IndexedSearchSpace<ArcType> space;
+			for (int b = next++; b < (int)boundary.size(); b = next++)
+			{
+				unsigned int region = m_region[boundary[b]];
+				unsigned char bit = (unsigned char)(1 << (region % 8));
+				reverse.ucs(boundary[b], space);
+				for (NodeId from = 0; from < graph.nodeCount(); from++)
+				{
+					if (!space.reached(from))
+					{
+						continue;
+					}
+					for (unsigned int arc = graph.firstArc(from); arc < graph.firstArc(from + 1); arc++)
+					{
+						NodeId to = graph.arcTarget(arc);
+						if (space.reached(to) && space.costDist(to) + graph.arcWeight(arc) == space.costDist(from))
+						{
+							flags[arc * m_bytes + region / 8] |= bit;
+						}
+					}
+				}
+			}
+		}));
+	}
+	for (int t = 0; t < threads; t++)
+	{
+		workers[t].join();
+		for (size_t i = 0; i < m_flags.size(); i++)
+		{
+			m_flags[i] |= found[t][i];
+		}
+		std::vector<unsigned char>().swap(found[t]);
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           search
+//  Description:    A* (or uniform cost search when useEstimate is
+//                  false) from start to dest, on BestFirstSearch like
+//                  IndexedGraph::search but only following arcs
+//                  flagged for the destination's region. The costs
+//                  and paths found are the same as without the flags.
+//  Arguments:      The start and destination, whether to use the
+//                  straight line estimate, the search space to work
+//                  in and the vector the path is written to.
+//  Return Value:   true if a path was found.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool ArcFlags<NodeType, ArcType>::search(NodeId start, NodeId dest, bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+{
+	IndexedGraph<NodeType, ArcType> const & graph = m_graph;
+	FlaggedArcs arcs = { *this, m_region[dest] / 8, (unsigned char)(1 << (m_region[dest] % 8)) };
+
+	space.reset(graph.nodeCount());
+	BestFirstSearch<ArcType, IndexedSearchSpace<ArcType> > bestFirst(space);
+	bestFirst.start(start, 0, useEstimate ? graph.estimate(start, dest) : 0);
+	NodeId goal = bestFirst.run(arcs, [&](NodeId node) { return useEstimate ? graph.estimate(node, dest) : ArcType(); },
+		[&](NodeId node) { return node == dest; });
+	if (goal == invalidNodeId())
+	{
+		return false;
+	}
+	space.path(goal, path);
+	return true;
+}
+
+#endif
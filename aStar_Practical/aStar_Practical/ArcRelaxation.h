@@ -0,0 +1,337 @@
+#ifndef ARCRELAXATION_H
+#define ARCRELAXATION_H
+
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "GraphPosition.h"
+
+// ----------------------------------------------------------------
+//  Name:           RelaxedArc
+//  Description:    An arc whose tentative cost beat the cost its
+//                  target had when the arcs were relaxed. Several arcs
+//                  to the same target can come out of one call, so
+//                  the caller checks each against the search space
+//                  again as it applies them.
+// ----------------------------------------------------------------
+template<class ArcType>
+struct RelaxedArc {
+	unsigned int node;
+	ArcType costDist;
+	ArcType f;
+};
+
+// ----------------------------------------------------------------
+//  Name:           ArcBatch
+//  Description:    Everything the relaxation kernel reads: the arcs
+//                  of the node being expanded, and the search and
+//                  position arrays of the whole graph. A child's cost
+//                  only counts if its stamp matches the generation
+//                  (see IndexedSearchSpace); otherwise it has not been
+//                  reached and counts as unreachable. nodes is the
+//                  length of those arrays.
+// ----------------------------------------------------------------
+template<class ArcType>
+struct ArcBatch {
+	unsigned int const * pTarget;
+	ArcType const * pWeight;
+	unsigned int count;
+	ArcType costDist;
+
+	ArcType const * pChildCost;
+	unsigned int const * pStamp;
+	unsigned int generation;
+	unsigned int nodes;
+
+	GraphPosition const * pPos;
+	GraphPosition goal;
+	float scale;
+	bool useEstimate;
+};
+
+// ----------------------------------------------------------------
+//  Name:           relaxArcsScalar
+//  Description:    Relaxes the arcs from one index to the end of the
+//                  batch one at a time. The vector kernels use it for
+//                  the arcs left over after the last full vector, and
+//                  it is the whole kernel for types they do not cover.
+//  Arguments:      The batch, the first arc and the array the
+//                  improved arcs are written to.
+//  Return Value:   The number of improved arcs written.
+// ----------------------------------------------------------------
+template<class ArcType>
+int relaxArcsScalar(ArcBatch<ArcType> const & batch, unsigned int first, RelaxedArc<ArcType>* pOut)
+{
+	int improved = 0;
+	for (unsigned int i = first; i < batch.count; i++)
+	{
+		unsigned int child = batch.pTarget[i];
+		ArcType dist = batch.costDist + batch.pWeight[i];
+		bool reached = batch.pStamp[child] == batch.generation;
+		if (!reached || dist < batch.pChildCost[child])
+		{
+			ArcType estimate = 0;
+			if (batch.useEstimate)
+			{
+				float x = batch.goal.x - batch.pPos[child].x;
+				float y = batch.goal.y - batch.pPos[child].y;
+				estimate = (ArcType)(batch.scale * std::sqrt(x * x + y * y));
+			}
+			RelaxedArc<ArcType> arc = { child, dist, dist + estimate };
+			pOut[improved++] = arc;
+		}
+	}
+	return improved;
+}
+
+// ----------------------------------------------------------------
+//  Name:           gatherable
+//  Description:    The vector kernels gather with signed 32 bit
+//                  offsets, and a position's offset is twice its
+//                  node's id, so they can only reach the first 2^30
+//                  nodes. Bigger graphs use the scalar kernel.
+//  Arguments:      The batch.
+//  Return Value:   true if every node's data is in gather range.
+// ----------------------------------------------------------------
+template<class ArcType>
+bool gatherable(ArcBatch<ArcType> const & batch)
+{
+	return batch.nodes <= (1u << 30);
+}
+
+// ----------------------------------------------------------------
+//  Name:           relaxArcs
+//  Description:    Works out the tentative cost of every arc of a
+//                  node and writes out the ones that improve on their
+//                  target's cost, with their f value. This generic
+//                  version is scalar; int and float costs have vector
+//                  versions below when the compiler targets AVX2 or
+//                  AVX-512 (/arch:AVX2 in Visual Studio, -mavx2 or
+//                  -mavx512f in gcc), which handle 8 or 16 arcs at a
+//                  time, on graphs of up to 2^30 nodes (see
+//                  gatherable). Every version gives the same results.
+//  Arguments:      The batch and the array the improved arcs are
+//                  written to, with room for batch.count of them.
+//  Return Value:   The number of improved arcs written.
+// ----------------------------------------------------------------
+template<class ArcType>
+int relaxArcs(ArcBatch<ArcType> const & batch, RelaxedArc<ArcType>* pOut)
+{
+	return relaxArcsScalar(batch, 0, pOut);
+}
+
+#if defined(__AVX512F__)
+
+// ----------------------------------------------------------------
+//  Description:    AVX-512: gathers 16 targets' stamps, costs and
+//                  positions at once and compares them with masks.
+// ----------------------------------------------------------------
+template<class ArcType>
+inline __m512 gatherEstimate16(ArcBatch<ArcType> const & batch, __m512i targets)
+{
+	__m512i xIndex = _mm512_slli_epi32(targets, 1);
+	float const * pPos = (float const *)batch.pPos;
+	__m512 x = _mm512_sub_ps(_mm512_set1_ps(batch.goal.x), _mm512_i32gather_ps(xIndex, pPos, 4));
+	__m512 y = _mm512_sub_ps(_mm512_set1_ps(batch.goal.y), _mm512_i32gather_ps(xIndex, pPos + 1, 4));
+	__m512 length = _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y)));
+	return _mm512_mul_ps(_mm512_set1_ps(batch.scale), length);
+}
+
+inline int relaxArcs(ArcBatch<int> const & batch, RelaxedArc<int>* pOut)
+{
+	if (!gatherable(batch))
+	{
+		return relaxArcsScalar(batch, 0, pOut);
+	}
+	int improved = 0;
+	unsigned int i = 0;
+	__m512i costDist = _mm512_set1_epi32(batch.costDist);
+	__m512i generation = _mm512_set1_epi32((int)batch.generation);
+	for (; i + 16 <= batch.count; i += 16)
+	{
+		__m512i targets = _mm512_loadu_si512((void const *)(batch.pTarget + i));
+		__m512i dist = _mm512_add_epi32(costDist, _mm512_loadu_si512((void const *)(batch.pWeight + i)));
+		__mmask16 reached = _mm512_cmpeq_epi32_mask(_mm512_i32gather_epi32(targets, (void const *)batch.pStamp, 4), generation);
+		__m512i childCost = _mm512_mask_i32gather_epi32(_mm512_set1_epi32(std::numeric_limits<int>::max()), reached,
+			targets, (void const *)batch.pChildCost, 4);
+		// unreached children always improve, even on the largest cost.
+		__mmask16 better = _mm512_cmplt_epi32_mask(dist, childCost) | (__mmask16)~reached;
+		if (better == 0)
+		{
+			continue;
+		}
+		__m512i f = dist;
+		if (batch.useEstimate)
+		{
+			f = _mm512_add_epi32(dist, _mm512_cvttps_epi32(gatherEstimate16(batch, targets)));
+		}
+		int distLanes[16], fLanes[16];
+		_mm512_storeu_si512((void*)distLanes, dist);
+		_mm512_storeu_si512((void*)fLanes, f);
+		for (unsigned int lane = 0; lane < 16; lane++)
+		{
+			if (better & (1u << lane))
+			{
+				RelaxedArc<int> arc = { batch.pTarget[i + lane], distLanes[lane], fLanes[lane] };
+				pOut[improved++] = arc;
+			}
+		}
+	}
+	return improved + relaxArcsScalar(batch, i, pOut + improved);
+}
+
+inline int relaxArcs(ArcBatch<float> const & batch, RelaxedArc<float>* pOut)
+{
+	if (!gatherable(batch))
+	{
+		return relaxArcsScalar(batch, 0, pOut);
+	}
+	int improved = 0;
+	unsigned int i = 0;
+	__m512 costDist = _mm512_set1_ps(batch.costDist);
+	__m512i generation = _mm512_set1_epi32((int)batch.generation);
+	for (; i + 16 <= batch.count; i += 16)
+	{
+		__m512i targets = _mm512_loadu_si512((void const *)(batch.pTarget + i));
+		__m512 dist = _mm512_add_ps(costDist, _mm512_loadu_ps(batch.pWeight + i));
+		__mmask16 reached = _mm512_cmpeq_epi32_mask(_mm512_i32gather_epi32(targets, (void const *)batch.pStamp, 4), generation);
+		__m512 childCost = _mm512_mask_i32gather_ps(_mm512_set1_ps(std::numeric_limits<float>::max()), reached,
+			targets, batch.pChildCost, 4);
+		__mmask16 better = _mm512_cmp_ps_mask(dist, childCost, _CMP_LT_OQ) | (__mmask16)~reached;
+		if (better == 0)
+		{
+			continue;
+		}
+		__m512 f = dist;
+		if (batch.useEstimate)
+		{
+			f = _mm512_add_ps(dist, gatherEstimate16(batch, targets));
+		}
+		float distLanes[16], fLanes[16];
+		_mm512_storeu_ps(distLanes, dist);
+		_mm512_storeu_ps(fLanes, f);
+		for (unsigned int lane = 0; lane < 16; lane++)
+		{
+			if (better & (1u << lane))
+			{
+				RelaxedArc<float> arc = { batch.pTarget[i + lane], distLanes[lane], fLanes[lane] };
+				pOut[improved++] = arc;
+			}
+		}
+	}
+	return improved + relaxArcsScalar(batch, i, pOut + improved);
+}
+
+#elif defined(__AVX2__)
+
+// ----------------------------------------------------------------
+//  Description:    AVX2: gathers 8 targets' stamps, costs and
+//                  positions at once. Comparisons give a lane mask,
+//                  and only the lanes set in it are written out.
+// ----------------------------------------------------------------
+template<class ArcType>
+inline __m256 gatherEstimate8(ArcBatch<ArcType> const & batch, __m256i targets)
+{
+	__m256i xIndex = _mm256_slli_epi32(targets, 1);
+	float const * pPos = (float const *)batch.pPos;
+	__m256 x = _mm256_sub_ps(_mm256_set1_ps(batch.goal.x), _mm256_i32gather_ps(pPos, xIndex, 4));
+	__m256 y = _mm256_sub_ps(_mm256_set1_ps(batch.goal.y), _mm256_i32gather_ps(pPos + 1, xIndex, 4));
+	__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)));
+	return _mm256_mul_ps(_mm256_set1_ps(batch.scale), length);
+}
+
+inline int relaxArcs(ArcBatch<int> const & batch, RelaxedArc<int>* pOut)
+{
+	if (!gatherable(batch))
+	{
+		return relaxArcsScalar(batch, 0, pOut);
+	}
+	int improved = 0;
+	unsigned int i = 0;
+	__m256i costDist = _mm256_set1_epi32(batch.costDist);
+	__m256i generation = _mm256_set1_epi32((int)batch.generation);
+	__m256i largest = _mm256_set1_epi32(std::numeric_limits<int>::max());
+	for (; i + 8 <= batch.count; i += 8)
+	{
+		__m256i targets = _mm256_loadu_si256((__m256i const *)(batch.pTarget + i));
+		__m256i dist = _mm256_add_epi32(costDist, _mm256_loadu_si256((__m256i const *)(batch.pWeight + i)));
+		__m256i reached = _mm256_cmpeq_epi32(_mm256_i32gather_epi32((int const *)batch.pStamp, targets, 4), generation);
+		__m256i childCost = _mm256_mask_i32gather_epi32(largest, batch.pChildCost, targets, reached, 4);
+		// unreached children always improve, even on the largest cost.
+		__m256i better = _mm256_or_si256(_mm256_cmpgt_epi32(childCost, dist), _mm256_andnot_si256(reached, _mm256_set1_epi32(-1)));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(better));
+		if (mask == 0)
+		{
+			continue;
+		}
+		__m256i f = dist;
+		if (batch.useEstimate)
+		{
+			f = _mm256_add_epi32(dist, _mm256_cvttps_epi32(gatherEstimate8(batch, targets)));
+		}
+		int distLanes[8], fLanes[8];
+		_mm256_storeu_si256((__m256i*)distLanes, dist);
+		_mm256_storeu_si256((__m256i*)fLanes, f);
+		for (unsigned int lane = 0; lane < 8; lane++)
+		{
+			if (mask & (1 << lane))
+			{
+				RelaxedArc<int> arc = { batch.pTarget[i + lane], distLanes[lane], fLanes[lane] };
+				pOut[improved++] = arc;
+			}
+		}
+	}
+	return improved + relaxArcsScalar(batch, i, pOut + improved);
+}
+
+inline int relaxArcs(ArcBatch<float> const & batch, RelaxedArc<float>* pOut)
+{
+	if (!gatherable(batch))
+	{
+		return relaxArcsScalar(batch, 0, pOut);
+	}
+	int improved = 0;
+	unsigned int i = 0;
+	__m256 costDist = _mm256_set1_ps(batch.costDist);
+	__m256i generation = _mm256_set1_epi32((int)batch.generation);
+	__m256 largest = _mm256_set1_ps(std::numeric_limits<float>::max());
+	for (; i + 8 <= batch.count; i += 8)
+	{
+		__m256i targets = _mm256_loadu_si256((__m256i const *)(batch.pTarget + i));
+		__m256 dist = _mm256_add_ps(costDist, _mm256_loadu_ps(batch.pWeight + i));
+		__m256i reached = _mm256_cmpeq_epi32(_mm256_i32gather_epi32((int const *)batch.pStamp, targets, 4), generation);
+		__m256 childCost = _mm256_mask_i32gather_ps(largest, batch.pChildCost, targets, _mm256_castsi256_ps(reached), 4);
+		__m256 better = _mm256_or_ps(_mm256_cmp_ps(dist, childCost, _CMP_LT_OQ),
+			_mm256_castsi256_ps(_mm256_andnot_si256(reached, _mm256_set1_epi32(-1))));
+		int mask = _mm256_movemask_ps(better);
+		if (mask == 0)
+		{
+			continue;
+		}
+		__m256 f = dist;
+		if (batch.useEstimate)
+		{
+			f = _mm256_add_ps(dist, gatherEstimate8(batch, targets));
+		}
+		float distLanes[8], fLanes[8];
+		_mm256_storeu_ps(distLanes, dist);
+		_mm256_storeu_ps(fLanes, f);
+		for (unsigned int lane = 0; lane < 8; lane++)
+		{
+			if (mask & (1 << lane))
+			{
+				RelaxedArc<float> arc = { batch.pTarget[i + lane], distLanes[lane], fLanes[lane] };
+				pOut[improved++] = arc;
+			}
+		}
+	}
+	return improved + relaxArcsScalar(batch, i, pOut + improved);
+}
+
+#endif
+
+#endif
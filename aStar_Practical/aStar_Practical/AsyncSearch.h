@@ -0,0 +1,331 @@
+#ifndef ASYNCSEARCH_H
+#define ASYNCSEARCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Graph.h"
+
+// ----------------------------------------------------------------
+//  Name:           SearchProgress
+//  Description:    A copy of the per node search state, taken while
+//                  a search runs so it can be drawn without touching
+//                  the nodes the worker is writing to.
+// ----------------------------------------------------------------
+struct SearchProgress {
+	std::vector<int> costDist;
+	std::vector<int> estGoalDist;
+	std::vector<char> marked;
+	int expanded;
+	bool finished;
+
+	SearchProgress() : expanded(0), finished(false) {}
+
+	// Copies the state of every node in the graph.
+	template<class NodeType, class ArcType>
+	void capture(Graph<NodeType, ArcType> const & graph)
+	{
+		int size = graph.maxNodes();
+		costDist.assign(size, 0);
+		estGoalDist.assign(size, 0);
+		marked.assign(size, 0);
+		for (int i = 0; i < size; i++)
+		{
+			GraphNode<NodeType, ArcType>* pNode = graph.nodeArray()[i];
+			if (pNode != 0)
+			{
+				costDist[i] = pNode->getCostDist();
+				estGoalDist[i] = pNode->getEstGoalDist();
+				marked[i] = pNode->marked();
+			}
+		}
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           SearchJob
+//  Description:    A single A* search handed to a SearchWorkerPool.
+//                  The job is the handle the caller keeps: it holds
+//                  the future for the path, the latest progress
+//                  snapshot and the cancel flag.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class SearchJob : public Graph<NodeType, ArcType>::SearchObserver {
+private:
+	typedef GraphNode<NodeType, ArcType> Node;
+
+	Graph<NodeType, ArcType>& m_graph;
+	Node* m_pStart;
+	Node* m_pDest;
+	void(*m_pProcess)(Node*);
+
+	std::atomic<bool> m_cancelled;
+	std::promise<std::vector<Node*> > m_promise;
+	std::shared_future<std::vector<Node*> > m_result;
+
+// ----------------------------------------------------------------
+//  Description:    The last published snapshot. m_version goes up
+//                  each time it is replaced so callers only copy
+//                  it when something changed.
+// ----------------------------------------------------------------
+	std::mutex m_progressMutex;
+	SearchProgress m_progress;
+	unsigned m_version;
+
+	int m_expanded;
+	std::chrono::steady_clock::time_point m_lastPublish;
+
+	SearchJob(SearchJob const &);
+	SearchJob& operator=(SearchJob const &);
+
+	void publish(bool finished)
+	{
+		SearchProgress progress;
+		progress.capture(m_graph);
+		progress.expanded = m_expanded;
+		progress.finished = finished;
+
+		std::lock_guard<std::mutex> lock(m_progressMutex);
+		std::swap(m_progress, progress);
+		m_version++;
+	}
+
+public:
+// ----------------------------------------------------------------
+//  Description:    How often a running search publishes a snapshot.
+//                  Capturing copies every node so it is throttled.
+// ----------------------------------------------------------------
+	static std::chrono::milliseconds publishInterval()
+	{
+		return std::chrono::milliseconds(8);
+	}
+
+	SearchJob(Graph<NodeType, ArcType>& graph, Node* pStart, Node* pDest, void(*pProcess)(Node*))
+		: m_graph(graph), m_pStart(pStart), m_pDest(pDest), m_pProcess(pProcess),
+		m_cancelled(false), m_version(0), m_expanded(0)
+	{
+		m_result = m_promise.get_future().share();
+	}
+
+	Graph<NodeType, ArcType> const & graph() const
+	{
+		return m_graph;
+	}
+
+	// Runs the search on the calling thread. Called by the pool.
+	void run()
+	{
+		std::vector<Node*> path;
+		m_lastPublish = std::chrono::steady_clock::now();
+		if (!m_cancelled)
+		{
+			m_graph.aStar(m_pStart, m_pDest, *this, path);
+		}
+		publish(true);
+		m_promise.set_value(path);
+	}
+
+	void expanded(Node* pNode)
+	{
+		m_expanded++;
+		if (m_pProcess != 0)
+		{
+			m_pProcess(pNode);
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - m_lastPublish >= publishInterval())
+		{
+			publish(false);
+			m_lastPublish = now;
+		}
+	}
+
+	bool cancelled()
+	{
+		return m_cancelled;
+	}
+
+	// Asks the search to stop at its next expansion. The path of a
+	// cancelled search is empty.
+	void cancel()
+	{
+		m_cancelled = true;
+	}
+
+	bool ready() const
+	{
+		return m_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void wait() const
+	{
+		m_result.wait();
+	}
+
+	std::shared_future<std::vector<Node*> > result() const
+	{
+		return m_result;
+	}
+
+// ----------------------------------------------------------------
+//  Name:           progress
+//  Description:    Copies the latest snapshot into the parameter if
+//                  it is newer than the one the caller already has.
+//  Arguments:      The snapshot to update and the version it holds.
+//  Return Value:   true if the snapshot was updated.
+// ----------------------------------------------------------------
+	bool progress(SearchProgress& progress, unsigned& version)
+	{
+		std::lock_guard<std::mutex> lock(m_progressMutex);
+		if (version == m_version)
+		{
+			return false;
+		}
+		progress = m_progress;
+		version = m_version;
+		return true;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           SearchWorkerPool
+//  Description:    Runs SearchJobs on a fixed set of worker threads.
+//                  A search writes its state into the graph's nodes,
+//                  so jobs on the same graph are run one at a time;
+//                  jobs on different graphs run side by side. The
+//                  graph must not be edited while it has jobs queued.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class SearchWorkerPool {
+private:
+	typedef GraphNode<NodeType, ArcType> Node;
+	typedef SearchJob<NodeType, ArcType> Job;
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::shared_ptr<Job> > m_queue;
+	std::vector<std::shared_ptr<Job> > m_running;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping;
+
+	SearchWorkerPool(SearchWorkerPool const &);
+	SearchWorkerPool& operator=(SearchWorkerPool const &);
+
+	bool graphBusy(Graph<NodeType, ArcType> const * pGraph) const
+	{
+		for (size_t i = 0; i < m_running.size(); i++)
+		{
+			if (&m_running[i]->graph() == pGraph)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Takes the first queued job whose graph is not being searched.
+	std::shared_ptr<Job> takeJob()
+	{
+		typename std::deque<std::shared_ptr<Job> >::iterator iter = m_queue.begin();
+		for (; iter != m_queue.end(); ++iter)
+		{
+			if (!graphBusy(&(*iter)->graph()))
+			{
+				std::shared_ptr<Job> job = *iter;
+				m_queue.erase(iter);
+				m_running.push_back(job);
+				return job;
+			}
+		}
+		return std::shared_ptr<Job>();
+	}
+
+	void workerLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			std::shared_ptr<Job> job = takeJob();
+			if (!job)
+			{
+				if (m_stopping)
+				{
+					return;
+				}
+				m_wake.wait(lock);
+				continue;
+			}
+
+			lock.unlock();
+			job->run();
+			lock.lock();
+
+			m_running.erase(find(m_running.begin(), m_running.end(), job));
+			m_wake.notify_all();
+		}
+	}
+
+public:
+	SearchWorkerPool(int workers) : m_stopping(false)
+	{
+		for (int i = 0; i < workers; i++)
+		{
+			m_workers.push_back(std::thread(&SearchWorkerPool::workerLoop, this));
+		}
+	}
+
+	// Cancels every queued and running job and joins the workers.
+	// Running searches stop at their next expansion and queued ones
+	// are still taken, so every job's path is set (empty) first.
+	~SearchWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+			for (size_t i = 0; i < m_queue.size(); i++)
+			{
+				m_queue[i]->cancel();
+			}
+			for (size_t i = 0; i < m_running.size(); i++)
+			{
+				m_running[i]->cancel();
+			}
+		}
+		m_wake.notify_all();
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			m_workers[i].join();
+		}
+	}
+
+// ----------------------------------------------------------------
+//  Name:           submit
+//  Description:    Queues an A* search and returns straight away.
+//  Arguments:      The graph, the start and destination nodes and
+//                  an optional function run on each expanded node
+//                  (called on the worker thread).
+//  Return Value:   The job, used to poll progress, cancel or wait
+//                  for the path.
+// ----------------------------------------------------------------
+	std::shared_ptr<Job> submit(Graph<NodeType, ArcType>& graph, Node* pStart, Node* pDest, void(*pProcess)(Node*) = 0)
+	{
+		std::shared_ptr<Job> job(new Job(graph, pStart, pDest, pProcess));
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(job);
+		}
+		m_wake.notify_one();
+		return job;
+	}
+};
+
+#endif
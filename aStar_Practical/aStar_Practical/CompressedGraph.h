@@ -0,0 +1,327 @@
+#ifndef COMPRESSEDGRAPH_H
+#define COMPRESSEDGRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           CompressedGraph
+//  Description:    A read only graph with its arcs packed into one
+//                  byte stream. Each node's arcs are sorted by target
+//                  and stored as the arc count, then for every arc the
+//                  gap to its target and its weight's code, all as
+//                  variable length integers (7 bits a byte, the top
+//                  bit set on every byte but the last). The first gap
+//                  is from the node itself and may be negative, so it
+//                  is zigzag coded; the rest are from the previous
+//                  target and never are. Weights are looked up in a
+//                  dictionary sorted by how often they occur, so the
+//                  127 most common weights take one byte.
+//                  After a locality improving reordering (see
+//                  NodeOrder.h) most gaps are small and an arc takes
+//                  two or three bytes, against the 40 or so of a
+//                  GraphArc in a std::list.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class CompressedGraph {
+private:
+	std::vector<unsigned int> m_firstByte;
+	std::vector<unsigned char> m_bytes;
+	std::vector<ArcType> m_weights;
+	unsigned int m_arcs;
+
+	std::vector<NodeType> m_data;
+	std::vector<GraphPosition> m_pos;
+	float m_scale;
+
+	static void writeVarint(std::vector<unsigned char>& bytes, unsigned int value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back((unsigned char)value);
+	}
+
+	// Decodes a node's arcs with ArcIterator, for BestFirstSearch.
+	struct DecodedArcs {
+		CompressedGraph const & graph;
+
+		template<class Relax>
+		bool operator()(NodeId node, Relax& relax) const
+		{
+			for (ArcIterator it = graph.arcs(node); it.next(); )
+			{
+				relax(it.target(), it.weight());
+			}
+			return true;
+		}
+	};
+
+	bool search(NodeId start, NodeId dest, bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const;
+
+public:
+	static unsigned int readVarint(unsigned char const * & pBytes)
+	{
+		unsigned int value = *pBytes++;
+		if (value < 0x80)
+		{
+			return value;
+		}
+		value &= 0x7F;
+		for (int shift = 7; ; shift += 7)
+		{
+			unsigned int byte = *pBytes++;
+			value |= (byte & 0x7F) << shift;
+			if (byte < 0x80)
+			{
+				return value;
+			}
+		}
+	}
+
+// ----------------------------------------------------------------
+//  Name:           ArcIterator
+//  Description:    Decodes one node's arcs in order:
+//                      for (ArcIterator it = graph.arcs(n); it.next(); )
+//                          use it.target() and it.weight()
+// ----------------------------------------------------------------
+	class ArcIterator {
+	private:
+		unsigned char const * m_pBytes;
+		ArcType const * m_pWeights;
+		unsigned int m_remaining;
+		bool m_first;
+		NodeId m_target;
+		ArcType m_weight;
+
+	public:
+		ArcIterator(unsigned char const * pBytes, ArcType const * pWeights, NodeId node)
+			: m_pBytes(pBytes), m_pWeights(pWeights), m_first(true), m_target(node), m_weight(0)
+		{
+			m_remaining = readVarint(m_pBytes);
+		}
+
+		bool next()
+		{
+			if (m_remaining == 0)
+			{
+				return false;
+			}
+			m_remaining--;
+			unsigned int gap = readVarint(m_pBytes);
+			if (m_first)
+			{
+				// undo the zigzag: 0, -1, 1, -2, ... were stored as 0, 1, 2, 3, ...
+				m_target += (gap >> 1) ^ (0u - (gap & 1));
+				m_first = false;
+			}
+			else
+			{
+				m_target += gap;
+			}
+			m_weight = m_pWeights[readVarint(m_pBytes)];
+			return true;
+		}
+
+		NodeId target() const
+		{
+			return m_target;
+		}
+
+		ArcType weight() const
+		{
+			return m_weight;
+		}
+	};
+
+	explicit CompressedGraph(IndexedGraph<NodeType, ArcType> const & graph);
+
+	NodeId nodeCount() const
+	{
+		return (NodeId)m_data.size();
+	}
+
+	unsigned int arcCount() const
+	{
+		return m_arcs;
+	}
+
+	NodeType const & data(NodeId node) const
+	{
+		return m_data[node];
+	}
+
+	GraphPosition pos(NodeId node) const
+	{
+		return m_pos[node];
+	}
+
+	ArcIterator arcs(NodeId node) const
+	{
+		return ArcIterator(&m_bytes[m_firstByte[node]], &m_weights[0], node);
+	}
+
+	// Bytes used by the arcs: the stream, the offsets and the dictionary.
+	size_t arcBytes() const
+	{
+		return m_bytes.size() + m_firstByte.size() * sizeof(unsigned int) + m_weights.size() * sizeof(ArcType);
+	}
+
+	ArcType estimate(NodeId from, NodeId to) const
+	{
+		float x = m_pos[to].x - m_pos[from].x;
+		float y = m_pos[to].y - m_pos[from].y;
+		return (ArcType)(m_scale * sqrt(x * x + y * y));
+	}
+
+	bool aStar(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(start, dest, true, space, path);
+	}
+
+	bool ucs(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(start, dest, false, space, path);
+	}
+
+	void breadthFirst(NodeId start, std::vector<NodeId>& order) const;
+};
+
+// ----------------------------------------------------------------
+//  Name:           CompressedGraph
+//  Description:    Encodes a graph. Arcs are sorted by target per
+//                  node, so their order may differ from the graph's.
+//  Arguments:      The graph, ideally already reordered for locality.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+CompressedGraph<NodeType, ArcType>::CompressedGraph(IndexedGraph<NodeType, ArcType> const & graph)
+	: m_firstByte(graph.nodeCount() + 1, 0), m_arcs(graph.arcCount()), m_data(graph.nodeCount()), m_pos(graph.nodeCount()),
+	m_scale(graph.heuristicScale())
+{
+	// the dictionary, most common weight first.
+	std::map<ArcType, unsigned int> uses;
+	for (unsigned int arc = 0; arc < graph.arcCount(); arc++)
+	{
+		uses[graph.arcWeight(arc)]++;
+	}
+	std::vector<std::pair<unsigned int, ArcType> > byUse;
+	for (typename std::map<ArcType, unsigned int>::const_iterator iter = uses.begin(); iter != uses.end(); ++iter)
+	{
+		byUse.push_back(std::make_pair(iter->second, iter->first));
+	}
+	std::stable_sort(byUse.begin(), byUse.end(), [](std::pair<unsigned int, ArcType> const & a, std::pair<unsigned int, ArcType> const & b)
+	{
+		return a.first > b.first;
+	});
+	std::map<ArcType, unsigned int> code;
+	for (size_t i = 0; i < byUse.size(); i++)
+	{
+		m_weights.push_back(byUse[i].second);
+		code[byUse[i].second] = (unsigned int)i;
+	}
+	if (m_weights.empty())
+	{
+		m_weights.push_back(ArcType());
+	}
+
+	std::vector<std::pair<NodeId, ArcType> > arcs;
+	for (NodeId n = 0; n < graph.nodeCount(); n++)
+	{
+		m_data[n] = graph.data(n);
+		m_pos[n] = graph.pos(n);
+		m_firstByte[n] = (unsigned int)m_bytes.size();
+
+		arcs.clear();
+		for (unsigned int arc = graph.firstArc(n); arc < graph.firstArc(n + 1); arc++)
+		{
+			arcs.push_back(std::make_pair(graph.arcTarget(arc), graph.arcWeight(arc)));
+		}
+		std::sort(arcs.begin(), arcs.end());
+
+		writeVarint(m_bytes, (unsigned int)arcs.size());
+		NodeId previous = n;
+		for (size_t i = 0; i < arcs.size(); i++)
+		{
+			if (i == 0)
+			{
+				int gap = (int)(arcs[i].first - n);
+				writeVarint(m_bytes, ((unsigned int)gap << 1) ^ (unsigned int)(gap >> 31));
+			}
+			else
+			{
+				writeVarint(m_bytes, arcs[i].first - previous);
+			}
+			previous = arcs[i].first;
+			writeVarint(m_bytes, code[arcs[i].second]);
+		}
+	}
+	m_firstByte[graph.nodeCount()] = (unsigned int)m_bytes.size();
+	// one spare byte so arcs() on the end offset is still in bounds.
+	m_bytes.push_back(0);
+	std::vector<unsigned char>(m_bytes).swap(m_bytes);
+}
+
+// ----------------------------------------------------------------
+//  Name:           breadthFirst
+//  Description:    Breadth first traversal from the start.
+//  Arguments:      The start and the vector the nodes are written to
+//                  in the order they are reached.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void CompressedGraph<NodeType, ArcType>::breadthFirst(NodeId start, std::vector<NodeId>& order) const
+{
+	std::vector<char> marked(nodeCount(), false);
+	size_t head = order.size();
+	order.push_back(start);
+	marked[start] = true;
+	for (; head < order.size(); head++)
+	{
+		for (ArcIterator it = arcs(order[head]); it.next(); )
+		{
+			if (!marked[it.target()])
+			{
+				marked[it.target()] = true;
+				order.push_back(it.target());
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           search
+//  Description:    A* (or uniform cost search when useEstimate is
+//                  false) on BestFirstSearch, like
+//                  IndexedGraph::search but decoding the arcs as it
+//                  goes.
+//  Arguments:      The start and destination, whether to use the
+//                  straight line estimate, the search space to work
+//                  in and the vector the path is written to.
+//  Return Value:   true if a path was found.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool CompressedGraph<NodeType, ArcType>::search(NodeId start, NodeId dest, bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+{
+	space.reset(nodeCount());
+	BestFirstSearch<ArcType, IndexedSearchSpace<ArcType> > bestFirst(space);
+	bestFirst.start(start, 0, useEstimate ? estimate(start, dest) : 0);
+	DecodedArcs decoded = { *this };
+	NodeId goal = bestFirst.run(decoded, [&](NodeId node) { return useEstimate ? estimate(node, dest) : ArcType(); },
+		[&](NodeId node) { return node == dest; });
+	if (goal == invalidNodeId())
+	{
+		return false;
+	}
+	space.path(goal, path);
+	return true;
+}
+
+#endif
@@ -0,0 +1,633 @@
+#ifndef COOPERATIVEPLANNER_H
+#define COOPERATIVEPLANNER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           CooperativePlanner
+//  Description:    Plans routes for many agents on one IndexedGraph
+//                  so that they do not run into each other, in the
+//                  manner of windowed hierarchical cooperative A*
+//                  (WHCA*). Time is counted in ticks: an arc takes
+//                  its weight divided by the tick cost, rounded up,
+//                  and waiting a tick costs the tick cost. Agents are
+//                  planned one after another, each searching over
+//                  (node, tick) pairs and keeping out of the nodes
+//                  and arcs the agents planned before it have
+//                  reserved, then reserving its own route. Only the
+//                  next window of ticks is planned this way; past it
+//                  the search is finished off by the heuristic.
+//                  The heuristic is each agent's true distance to its
+//                  goal ignoring the other agents, from one uniform
+//                  cost search over the reversed graph per goal, run
+//                  only as far as it is asked about. Each plan()
+//                  carries the searches of all goals on to where their
+//                  agents stand across the threads, and they are kept
+//                  for as long as any agent is heading there, so
+//                  agents sharing a goal and every later window reuse
+//                  them. Each costs about one ArcType and a byte per
+//                  node.
+//                  Call plan(), move the agents along their routes,
+//                  advance() the clock by part of the window (half is
+//                  usual) and plan() again. The order agents are
+//                  planned in turns round each time so none is always
+//                  last. Like any WHCA*, it is not complete: in a
+//                  narrow corridor an agent can be kept from its goal
+//                  by others standing on theirs. The graph must
+//                  outlive the planner.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class CooperativePlanner {
+public:
+	// The agent is at node at tick (after a wait or an arc).
+	struct Step {
+		NodeId node;
+		unsigned int tick;
+	};
+
+private:
+	struct Agent {
+		NodeId goal;
+		// from the last step at or before now to the end of the window.
+		std::vector<Step> route;
+		bool blocked;
+	};
+
+	struct OpenEntry {
+		ArcType f;
+		ArcType costDist;
+		NodeId node;
+		unsigned int tick;
+
+		// ties go to the entry further along, which is nearer the end.
+		bool operator>(OpenEntry const & other) const
+		{
+			return f > other.f || (f == other.f && costDist < other.costDist);
+		}
+	};
+
+	struct Record {
+		ArcType costDist;
+		unsigned long long parent;
+		bool closed;
+	};
+
+	// An arc, either way round, in use during a tick.
+	struct ArcTick {
+		NodeId low;
+		NodeId high;
+		unsigned int tick;
+
+		bool operator==(ArcTick const & other) const
+		{
+			return low == other.low && high == other.high && tick == other.tick;
+		}
+	};
+
+	struct ArcTickHash {
+		size_t operator()(ArcTick const & key) const
+		{
+			return (size_t)(key.low * 2654435761u ^ key.high * 2246822519u ^ key.tick * 3266489917u);
+		}
+	};
+
+	typedef std::unordered_map<unsigned long long, int> NodeReservations;
+	typedef std::unordered_map<ArcTick, int, ArcTickHash> ArcReservations;
+
+	IndexedGraph<NodeType, ArcType> const & m_graph;
+	IndexedGraph<NodeType, ArcType> m_reverse;
+	unsigned int m_window;
+	ArcType m_tickCost;
+	int m_threads;
+
+	unsigned int m_now;
+	std::vector<Agent> m_agents;
+	size_t m_first;
+
+	// Distance to each goal, ignoring the agents: a uniform cost
+	// search back from the goal that is only run as far as it has been
+	// asked about (a reverse resumable search).
+	struct GoalDistance {
+		std::vector<ArcType> distance;
+		std::vector<char> closed;
+		std::vector<OpenEntry> open;
+	};
+	typedef std::map<NodeId, std::shared_ptr<GoalDistance> > GoalMap;
+	GoalMap m_toGoal;
+
+	// Which agent holds a node or an arc at a tick.
+	NodeReservations m_nodeHeld;
+	ArcReservations m_arcHeld;
+
+	// The search's (node, tick) records and open list, kept between
+	// searches so their memory is reused.
+	std::unordered_map<unsigned long long, Record> m_records;
+	std::vector<OpenEntry> m_open;
+
+	int m_expanded;
+	int m_blocked;
+	int m_heuristics;
+
+	CooperativePlanner(CooperativePlanner const &);
+	CooperativePlanner& operator=(CooperativePlanner const &);
+
+	static ArcType unreachable()
+	{
+		return std::numeric_limits<ArcType>::max();
+	}
+
+	static unsigned long long key(NodeId node, unsigned int tick)
+	{
+		return ((unsigned long long)node << 32) | tick;
+	}
+
+	unsigned int ticks(ArcType weight) const
+	{
+		return (unsigned int)std::max(1.0, std::ceil((double)weight / m_tickCost - 1e-9));
+	}
+
+	bool nodeFree(NodeId node, unsigned int tick, int agent) const
+	{
+		NodeReservations::const_iterator found = m_nodeHeld.find(key(node, tick));
+		return found == m_nodeHeld.end() || found->second == agent;
+	}
+
+	bool arcFree(NodeId from, NodeId to, unsigned int tick, int agent) const
+	{
+		ArcTick arcTick = { std::min(from, to), std::max(from, to), tick };
+		typename ArcReservations::const_iterator found = m_arcHeld.find(arcTick);
+		return found == m_arcHeld.end() || found->second == agent;
+	}
+
+	void refreshHeuristics();
+	ArcType toGoal(GoalDistance& goal, NodeId node) const;
+	void reserve(int agent, size_t from, bool settle);
+	bool search(int agent);
+	void trim();
+
+public:
+	CooperativePlanner(IndexedGraph<NodeType, ArcType> const & graph, int window, ArcType tickCost, int threads);
+
+	int addAgent(NodeId start, NodeId goal)
+	{
+		Agent agent;
+		agent.goal = goal;
+		Step step = { start, m_now };
+		agent.route.push_back(step);
+		agent.blocked = false;
+		m_agents.push_back(agent);
+		return (int)m_agents.size() - 1;
+	}
+
+	void setGoal(int agent, NodeId goal)
+	{
+		m_agents[agent].goal = goal;
+	}
+
+	int agentCount() const
+	{
+		return (int)m_agents.size();
+	}
+
+	unsigned int now() const
+	{
+		return m_now;
+	}
+
+	// The agent's planned steps, from where it was at or before now to
+	// the end of the window.
+	std::vector<Step> const & route(int agent) const
+	{
+		return m_agents[agent].route;
+	}
+
+	// The node the agent is at, or is leaving along an arc.
+	NodeId position(int agent) const
+	{
+		return m_agents[agent].route.front().node;
+	}
+
+	// Whether the agent is standing on its goal.
+	bool arrived(int agent) const
+	{
+		Agent const & a = m_agents[agent];
+		return a.route.front().node == a.goal && a.route.front().tick >= m_now;
+	}
+
+	// Whether the last plan() found no route clear of the others for
+	// the agent, which then waits where it is.
+	bool blocked(int agent) const
+	{
+		return m_agents[agent].blocked;
+	}
+
+	// Totals since the planner was made: (node, tick) pairs expanded,
+	// agents left blocked, and goal distance searches run.
+	int expanded() const
+	{
+		return m_expanded;
+	}
+
+	int blockedCount() const
+	{
+		return m_blocked;
+	}
+
+	int heuristicSearches() const
+	{
+		return m_heuristics;
+	}
+
+	void plan();
+	void advance(unsigned int ticks);
+};
+
+// ----------------------------------------------------------------
+//  Name:           CooperativePlanner
+//  Description:    Keeps the graph and a reversed copy of it for the
+//                  goal distance searches.
+//  Arguments:      The graph, the window in ticks, the weight one
+//                  tick covers (0 for the smallest arc weight) and
+//                  the number of threads for the goal distances.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+CooperativePlanner<NodeType, ArcType>::CooperativePlanner(IndexedGraph<NodeType, ArcType> const & graph, int window, ArcType tickCost, int threads)
+	: m_graph(graph), m_reverse(graph.reversed()), m_window((unsigned int)std::max(window, 1)), m_tickCost(tickCost),
+	m_threads(std::max(threads, 1)), m_now(0), m_first(0), m_expanded(0), m_blocked(0), m_heuristics(0)
+{
+	if (!(m_tickCost > 0))
+	{
+		m_tickCost = unreachable();
+		for (unsigned int arc = 0; arc < graph.arcCount(); arc++)
+		{
+			if (graph.arcWeight(arc) > 0)
+			{
+				m_tickCost = std::min(m_tickCost, graph.arcWeight(arc));
+			}
+		}
+		if (m_tickCost == unreachable())
+		{
+			m_tickCost = 1;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           refreshHeuristics
+//  Description:    Starts a goal distance search for every goal that
+//                  has none, drops those of goals no agent is heading
+//                  for any more, then carries each goal's search on
+//                  until it has reached the agents heading there.
+//                  Each goal's search is run by one thread at a time,
+//                  so the goals are shared out between the threads.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void CooperativePlanner<NodeType, ArcType>::refreshHeuristics()
+{
+	GoalMap kept;
+	std::map<NodeId, std::vector<NodeId> > starts;
+	for (size_t a = 0; a < m_agents.size(); a++)
+	{
+		NodeId goal = m_agents[a].goal;
+		starts[goal].push_back(m_agents[a].route.back().node);
+		if (kept.count(goal) != 0)
+		{
+			continue;
+		}
+		typename GoalMap::iterator found = m_toGoal.find(goal);
+		if (found != m_toGoal.end())
+		{
+			kept[goal] = found->second;
+		}
+		else
+		{
+			std::shared_ptr<GoalDistance> pDistance(new GoalDistance);
+			pDistance->distance.assign(m_graph.nodeCount(), unreachable());
+			pDistance->closed.assign(m_graph.nodeCount(), false);
+			pDistance->distance[goal] = 0;
+			OpenEntry first = { 0, 0, goal, 0 };
+			pDistance->open.push_back(first);
+			kept[goal] = pDistance;
+			m_heuristics++;
+		}
+	}
+	m_toGoal.swap(kept);
+
+	std::vector<std::pair<GoalDistance*, std::vector<NodeId>*> > work;
+	for (typename GoalMap::iterator iter = m_toGoal.begin(); iter != m_toGoal.end(); ++iter)
+	{
+		work.push_back(std::make_pair(iter->second.get(), &starts[iter->first]));
+	}
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < m_threads && t < (int)work.size(); t++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for (int w = next++; w < (int)work.size(); w = next++)
+			{
+				std::vector<NodeId> const & from = *work[w].second;
+				for (size_t i = 0; i < from.size(); i++)
+				{
+					toGoal(*work[w].first, from[i]);
+				}
+			}
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           toGoal
+//  Description:    A node's distance to a goal. The goal's uniform
+//                  cost search over the reversed graph is carried on
+//                  from where it stopped until the node is settled,
+//                  so only as much of the map is searched as the
+//                  agents have asked about.
+//  Arguments:      The goal's search and the node.
+//  Return Value:   The distance, or unreachable().
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+ArcType CooperativePlanner<NodeType, ArcType>::toGoal(GoalDistance& goal, NodeId node) const
+{
+	std::vector<OpenEntry>& open = goal.open;
+	while (!goal.closed[node] && !open.empty())
+	{
+		OpenEntry top = open.front();
+		std::pop_heap(open.begin(), open.end(), std::greater<OpenEntry>());
+		open.pop_back();
+		if (goal.closed[top.node])
+		{
+			continue;
+		}
+		goal.closed[top.node] = true;
+		for (unsigned int arc = m_reverse.firstArc(top.node); arc < m_reverse.firstArc(top.node + 1); arc++)
+		{
+			NodeId to = m_reverse.arcTarget(arc);
+			ArcType dist = top.costDist + m_reverse.arcWeight(arc);
+			if (!goal.closed[to] && dist < goal.distance[to])
+			{
+				goal.distance[to] = dist;
+				OpenEntry entry = { dist, dist, to, 0 };
+				open.push_back(entry);
+				std::push_heap(open.begin(), open.end(), std::greater<OpenEntry>());
+			}
+		}
+	}
+	return goal.closed[node] ? goal.distance[node] : unreachable();
+}
+
+// ----------------------------------------------------------------
+//  Name:           reserve
+//  Description:    Reserves an agent's route from one step on: the
+//                  node at every step, and the arc between two steps
+//                  for every tick spent on it, so no one can come the
+//                  other way. When settling a planned route, an agent
+//                  whose route ends at its goal, or who is blocked,
+//                  also keeps its last node to the end of the window.
+//  Arguments:      The agent, the first step to reserve and whether
+//                  the route is finished.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void CooperativePlanner<NodeType, ArcType>::reserve(int agent, size_t from, bool settle)
+{
+	Agent const & a = m_agents[agent];
+	for (size_t i = from; i < a.route.size(); i++)
+	{
+		Step const & step = a.route[i];
+		m_nodeHeld[key(step.node, step.tick)] = agent;
+		if (i + 1 < a.route.size() && a.route[i + 1].node != step.node)
+		{
+			NodeId to = a.route[i + 1].node;
+			for (unsigned int tick = step.tick; tick < a.route[i + 1].tick; tick++)
+			{
+				ArcTick arcTick = { std::min(step.node, to), std::max(step.node, to), tick };
+				m_arcHeld[arcTick] = agent;
+			}
+		}
+	}
+	Step const & last = a.route.back();
+	if (settle && (last.node == a.goal || a.blocked))
+	{
+		for (unsigned int tick = last.tick + 1; tick <= m_now + m_window; tick++)
+		{
+			m_nodeHeld.insert(std::make_pair(key(last.node, tick), agent));
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           search
+//  Description:    Space time A* for one agent from the last step of
+//                  its route. From (node, tick) it can wait a tick or
+//                  take an arc, if the node or arc is free at those
+//                  ticks. The search ends at the first (node, tick)
+//                  taken off the open list that is either the goal,
+//                  free to stay on until the window ends, or at or
+//                  past the end of the window; beyond that the goal
+//                  distance, which ignores the other agents, stands in
+//                  for the rest of the way. The steps found are added
+//                  to the route.
+//  Arguments:      The agent.
+//  Return Value:   false if every way out is blocked within the
+//                  window, or the goal cannot be reached at all.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool CooperativePlanner<NodeType, ArcType>::search(int agent)
+{
+	Agent& a = m_agents[agent];
+	GoalDistance& goalSearch = *m_toGoal[a.goal];
+	Step start = a.route.back();
+	unsigned int windowEnd = m_now + m_window;
+	if (toGoal(goalSearch, start.node) == unreachable())
+	{
+		return false;
+	}
+
+	std::unordered_map<unsigned long long, Record>& records = m_records;
+	std::vector<OpenEntry>& open = m_open;
+	records.clear();
+	open.clear();
+	Record first = { 0, key(start.node, start.tick), false };
+	records[key(start.node, start.tick)] = first;
+	OpenEntry entry = { toGoal(goalSearch, start.node), 0, start.node, start.tick };
+	open.push_back(entry);
+
+	while (!open.empty())
+	{
+		OpenEntry top = open.front();
+		std::pop_heap(open.begin(), open.end(), std::greater<OpenEntry>());
+		open.pop_back();
+		unsigned long long here = key(top.node, top.tick);
+		Record& record = records[here];
+		if (record.closed)
+		{
+			continue;
+		}
+		record.closed = true;
+		m_expanded++;
+
+		bool done = top.tick >= windowEnd;
+		if (!done && top.node == a.goal)
+		{
+			done = true;
+			for (unsigned int tick = top.tick + 1; tick <= windowEnd && done; tick++)
+			{
+				done = nodeFree(a.goal, tick, agent);
+			}
+		}
+		if (done)
+		{
+			size_t join = a.route.size();
+			for (unsigned long long at = here; at != key(start.node, start.tick); at = records[at].parent)
+			{
+				Step step = { (NodeId)(at >> 32), (unsigned int)at };
+				a.route.push_back(step);
+			}
+			std::reverse(a.route.begin() + join, a.route.end());
+			return true;
+		}
+
+		// waiting is an arc back to the same node.
+		for (unsigned int arc = m_graph.firstArc(top.node); arc <= m_graph.firstArc(top.node + 1); arc++)
+		{
+			bool wait = (arc == m_graph.firstArc(top.node + 1));
+			NodeId to = wait ? top.node : m_graph.arcTarget(arc);
+			ArcType weight = wait ? m_tickCost : m_graph.arcWeight(arc);
+			unsigned int tick = top.tick + (wait ? 1 : ticks(weight));
+			ArcType estimate = toGoal(goalSearch, to);
+			if (estimate == unreachable() || !nodeFree(to, tick, agent))
+			{
+				continue;
+			}
+			bool free = true;
+			for (unsigned int t = top.tick; t < tick && free && !wait; t++)
+			{
+				free = arcFree(top.node, to, t, agent);
+			}
+			if (!free)
+			{
+				continue;
+			}
+
+			ArcType dist = top.costDist + weight;
+			unsigned long long there = key(to, tick);
+			typename std::unordered_map<unsigned long long, Record>::iterator found = records.find(there);
+			if (found == records.end() || (!found->second.closed && dist < found->second.costDist))
+			{
+				Record next = { dist, here, false };
+				records[there] = next;
+				OpenEntry child = { dist + estimate, dist, to, tick };
+				open.push_back(child);
+				std::push_heap(open.begin(), open.end(), std::greater<OpenEntry>());
+			}
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           plan
+//  Description:    Plans every agent for the window starting now.
+//                  The steps agents have already started on are
+//                  reserved first, so no one plans through a place
+//                  another agent is in or is bound for; then each
+//                  agent in turn searches and reserves its route. An
+//                  agent no route can be found for waits where it is
+//                  and is marked blocked.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void CooperativePlanner<NodeType, ArcType>::plan()
+{
+	trim();
+	refreshHeuristics();
+	m_nodeHeld.clear();
+	m_arcHeld.clear();
+	for (size_t a = 0; a < m_agents.size(); a++)
+	{
+		m_agents[a].blocked = false;
+		reserve((int)a, 0, false);
+	}
+
+	for (size_t i = 0; i < m_agents.size(); i++)
+	{
+		int agent = (int)((m_first + i) % m_agents.size());
+		Agent& a = m_agents[agent];
+		// from the step the search starts at, for the arc leaving it.
+		size_t from = a.route.size() - 1;
+		if (!search(agent))
+		{
+			a.blocked = true;
+			m_blocked++;
+		}
+		reserve(agent, from, true);
+	}
+	m_first = m_agents.empty() ? 0 : (m_first + 1) % m_agents.size();
+}
+
+// ----------------------------------------------------------------
+//  Name:           advance
+//  Description:    Moves the clock on.
+//  Arguments:      The number of ticks.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void CooperativePlanner<NodeType, ArcType>::advance(unsigned int ticks)
+{
+	m_now += ticks;
+	trim();
+}
+
+// ----------------------------------------------------------------
+//  Name:           trim
+//  Description:    Cuts every route back to where the agent is now.
+//                  An agent part way along an arc keeps that move,
+//                  and its next plan starts where the arc ends.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void CooperativePlanner<NodeType, ArcType>::trim()
+{
+	for (size_t a = 0; a < m_agents.size(); a++)
+	{
+		std::vector<Step>& route = m_agents[a].route;
+		size_t at = 0;
+		while (at + 1 < route.size() && route[at + 1].tick <= m_now)
+		{
+			at++;
+		}
+		route.erase(route.begin(), route.begin() + at);
+		if (route.size() > 1 && route[1].node != route[0].node && route[0].tick < m_now)
+		{
+			route.resize(2);
+		}
+		else
+		{
+			route.resize(1);
+			route[0].tick = m_now;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,445 @@
+#ifndef DISTANCEORACLE_H
+#define DISTANCEORACLE_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DISTANCEORACLE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "Graph.h"
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           relaxRow
+//  Description:    The Floyd-Warshall inner loop: relaxes row i of
+//                  the cost and next hop matrices through node k for
+//                  the columns from begin to end. The rows must not
+//                  overlap, so it is never called with i == k. This
+//                  generic version is scalar; int and float costs
+//                  have SSE2 versions below, or AVX2 ones when the
+//                  compiler targets it (/arch:AVX2 in Visual Studio,
+//                  -mavx2 in gcc), and every version gives the same
+//                  results.
+//  Arguments:      The cost of i to k and the next hop from i towards
+//                  k, row k of the costs, row i of the costs and next
+//                  hops, and the columns to relax.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class ArcType>
+void relaxRow(ArcType ik, int ikNext, ArcType const * __restrict kDist,
+	ArcType* __restrict iDist, int* __restrict iNext, int begin, int end)
+{
+	for (int j = begin; j < end; j++)
+	{
+		ArcType through = ik + kDist[j];
+		if (through < iDist[j])
+		{
+			iDist[j] = through;
+			iNext[j] = ikNext;
+		}
+	}
+}
+
+#if defined(__AVX2__)
+
+// ----------------------------------------------------------------
+//  Description:    AVX2: 8 columns at a time. The comparison gives a
+//                  lane mask that blends the new cost and next hop
+//                  into both rows.
+// ----------------------------------------------------------------
+inline void relaxRow(int ik, int ikNext, int const * __restrict kDist,
+	int* __restrict iDist, int* __restrict iNext, int begin, int end)
+{
+	__m256i ikLanes = _mm256_set1_epi32(ik);
+	__m256i nextLanes = _mm256_set1_epi32(ikNext);
+	int j = begin;
+	for (; j + 8 <= end; j += 8)
+	{
+		__m256i through = _mm256_add_epi32(ikLanes, _mm256_loadu_si256((__m256i const *)(kDist + j)));
+		__m256i dist = _mm256_loadu_si256((__m256i const *)(iDist + j));
+		__m256i better = _mm256_cmpgt_epi32(dist, through);
+		__m256i next = _mm256_loadu_si256((__m256i const *)(iNext + j));
+		_mm256_storeu_si256((__m256i*)(iDist + j), _mm256_blendv_epi8(dist, through, better));
+		_mm256_storeu_si256((__m256i*)(iNext + j), _mm256_blendv_epi8(next, nextLanes, better));
+	}
+	relaxRow<int>(ik, ikNext, kDist, iDist, iNext, j, end);
+}
+
+inline void relaxRow(float ik, int ikNext, float const * __restrict kDist,
+	float* __restrict iDist, int* __restrict iNext, int begin, int end)
+{
+	__m256 ikLanes = _mm256_set1_ps(ik);
+	__m256 nextLanes = _mm256_castsi256_ps(_mm256_set1_epi32(ikNext));
+	int j = begin;
+	for (; j + 8 <= end; j += 8)
+	{
+		__m256 through = _mm256_add_ps(ikLanes, _mm256_loadu_ps(kDist + j));
+		__m256 dist = _mm256_loadu_ps(iDist + j);
+		__m256 better = _mm256_cmp_ps(through, dist, _CMP_LT_OQ);
+		__m256 next = _mm256_loadu_ps((float const *)(iNext + j));
+		_mm256_storeu_ps(iDist + j, _mm256_blendv_ps(dist, through, better));
+		_mm256_storeu_ps((float*)(iNext + j), _mm256_blendv_ps(next, nextLanes, better));
+	}
+	relaxRow<float>(ik, ikNext, kDist, iDist, iNext, j, end);
+}
+
+#elif defined(DISTANCEORACLE_SSE2)
+
+// ----------------------------------------------------------------
+//  Description:    SSE2: 4 columns at a time. SSE2 has no blend, so
+//                  the lane mask selects with and, andnot and or.
+// ----------------------------------------------------------------
+inline __m128i selectLanes(__m128i mask, __m128i yes, __m128i no)
+{
+	return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+inline void relaxRow(int ik, int ikNext, int const * __restrict kDist,
+	int* __restrict iDist, int* __restrict iNext, int begin, int end)
+{
+	__m128i ikLanes = _mm_set1_epi32(ik);
+	__m128i nextLanes = _mm_set1_epi32(ikNext);
+	int j = begin;
+	for (; j + 4 <= end; j += 4)
+	{
+		__m128i through = _mm_add_epi32(ikLanes, _mm_loadu_si128((__m128i const *)(kDist + j)));
+		__m128i dist = _mm_loadu_si128((__m128i const *)(iDist + j));
+		__m128i better = _mm_cmplt_epi32(through, dist);
+		__m128i next = _mm_loadu_si128((__m128i const *)(iNext + j));
+		_mm_storeu_si128((__m128i*)(iDist + j), selectLanes(better, through, dist));
+		_mm_storeu_si128((__m128i*)(iNext + j), selectLanes(better, nextLanes, next));
+	}
+	relaxRow<int>(ik, ikNext, kDist, iDist, iNext, j, end);
+}
+
+inline void relaxRow(float ik, int ikNext, float const * __restrict kDist,
+	float* __restrict iDist, int* __restrict iNext, int begin, int end)
+{
+	__m128 ikLanes = _mm_set1_ps(ik);
+	__m128i nextLanes = _mm_set1_epi32(ikNext);
+	int j = begin;
+	for (; j + 4 <= end; j += 4)
+	{
+		__m128 through = _mm_add_ps(ikLanes, _mm_loadu_ps(kDist + j));
+		__m128 dist = _mm_loadu_ps(iDist + j);
+		__m128 better = _mm_cmplt_ps(through, dist);
+		__m128i next = _mm_loadu_si128((__m128i const *)(iNext + j));
+		_mm_storeu_ps(iDist + j, _mm_or_ps(_mm_and_ps(better, through), _mm_andnot_ps(better, dist)));
+		_mm_storeu_si128((__m128i*)(iNext + j), selectLanes(_mm_castps_si128(better), nextLanes, next));
+	}
+	relaxRow<float>(ik, ikNext, kDist, iDist, iNext, j, end);
+}
+
+#endif
+
+// ----------------------------------------------------------------
+//  Name:           DistanceOracle
+//  Description:    All pairs shortest paths for small graphs that are
+//                  queried far more often than they change. It holds
+//                  an n x n matrix of costs and an n x n matrix of
+//                  next hops, so a cost is one lookup and a path is
+//                  one lookup per node on it.
+//                  Dense graphs are solved with a blocked Floyd-
+//                  Warshall whose inner loop (relaxRow) runs along
+//                  contiguous rows with SSE2 or AVX2 for int and
+//                  float costs. Sparse graphs are solved with a uniform cost
+//                  search from every node instead. The oracle listens
+//                  to the graph and rebuilds itself on the first
+//                  query after an edit.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class DistanceOracle : public Graph<NodeType, ArcType>::Listener {
+private:
+	typedef GraphArc<NodeType, ArcType> Arc;
+	typedef GraphNode<NodeType, ArcType> Node;
+
+	Graph<NodeType, ArcType>& m_graph;
+	int m_size;
+	bool m_dirty;
+
+// ----------------------------------------------------------------
+//  Description:    Row major matrices. m_next[from * n + to] is the
+//                  node after "from" on the best path, or -1.
+// ----------------------------------------------------------------
+	std::vector<ArcType> m_dist;
+	std::vector<int> m_next;
+
+	DistanceOracle(DistanceOracle const &);
+	DistanceOracle& operator=(DistanceOracle const &);
+
+	void floydWarshall();
+	void repeatedSearch();
+	void relaxBlock(int kBlock, int iBlock, int jBlock);
+
+public:
+// ----------------------------------------------------------------
+//  Description:    Edge length of a Floyd-Warshall block. Three
+//                  blocks of costs and next hops fit comfortably in
+//                  the L1 cache.
+// ----------------------------------------------------------------
+	static int blockSize()
+	{
+		return 32;
+	}
+
+	// Half the largest value, so that adding two of them cannot overflow.
+	static ArcType unreachable()
+	{
+		return numeric_limits<ArcType>::max() / 2;
+	}
+
+	DistanceOracle(Graph<NodeType, ArcType>& graph) : m_graph(graph), m_size(0), m_dirty(true)
+	{
+		m_graph.addListener(this);
+	}
+
+	~DistanceOracle()
+	{
+		m_graph.removeListener(this);
+	}
+
+	void rebuild();
+
+	ArcType distance(int from, int to)
+	{
+		if (m_dirty)
+		{
+			rebuild();
+		}
+		return m_dist[from * m_size + to];
+	}
+
+	int nextHop(int from, int to)
+	{
+		if (m_dirty)
+		{
+			rebuild();
+		}
+		return m_next[from * m_size + to];
+	}
+
+	bool path(int from, int to, std::vector<Node*>& path);
+
+	// Graph::Listener
+	void nodeAdded(int index) { m_dirty = true; }
+	void nodeRemoved(int index) { m_dirty = true; }
+	void arcAdded(int from, int to, ArcType weight) { m_dirty = true; }
+	void arcRemoved(int from, int to) { m_dirty = true; }
+};
+
+// ----------------------------------------------------------------
+//  Name:           rebuild
+//  Description:    Recomputes both matrices from the graph, choosing
+//                  Floyd-Warshall (n^3) or a search from every node
+//                  (about n * e log n) by whichever is cheaper.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void DistanceOracle<NodeType, ArcType>::rebuild()
+{
+	m_size = m_graph.maxNodes();
+	m_dist.assign(m_size * m_size, unreachable());
+	m_next.assign(m_size * m_size, -1);
+
+	long long arcs = 0;
+	for (int from = 0; from < m_size; from++)
+	{
+		Node* pNode = m_graph.nodeArray()[from];
+		if (pNode == 0)
+		{
+			continue;
+		}
+		m_dist[from * m_size + from] = 0;
+		m_next[from * m_size + from] = from;
+		typename list<Arc>::const_iterator iter = pNode->arcList().begin();
+		for (; iter != pNode->arcList().end(); ++iter)
+		{
+			int to = (*iter).node()->index();
+			if (to != from && (*iter).weight() < m_dist[from * m_size + to])
+			{
+				m_dist[from * m_size + to] = (*iter).weight();
+				m_next[from * m_size + to] = to;
+			}
+			arcs++;
+		}
+	}
+
+	long long logSize = 1;
+	while ((1LL << logSize) < m_size)
+	{
+		logSize++;
+	}
+	if (arcs * logSize < (long long)m_size * m_size)
+	{
+		repeatedSearch();
+	}
+	else
+	{
+		floydWarshall();
+	}
+	m_dirty = false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           relaxBlock
+//  Description:    Relaxes every pair in block (iBlock, jBlock)
+//                  through every k in block kBlock.
+//  Arguments:      The three block numbers.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void DistanceOracle<NodeType, ArcType>::relaxBlock(int kBlock, int iBlock, int jBlock)
+{
+	int n = m_size;
+	int kEnd = std::min((kBlock + 1) * blockSize(), n);
+	int iEnd = std::min((iBlock + 1) * blockSize(), n);
+	int jBegin = jBlock * blockSize();
+	int jEnd = std::min(jBegin + blockSize(), n);
+
+	for (int k = kBlock * blockSize(); k < kEnd; k++)
+	{
+		ArcType const * kDist = &m_dist[k * n];
+		for (int i = iBlock * blockSize(); i < iEnd; i++)
+		{
+			// Row k cannot improve through k, since dist[k][k] is 0,
+			// so skipping it keeps iDist and kDist apart.
+			ArcType ik = m_dist[i * n + k];
+			if (i == k || ik == unreachable())
+			{
+				continue;
+			}
+			relaxRow(ik, m_next[i * n + k], kDist, &m_dist[i * n], &m_next[i * n], jBegin, jEnd);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           floydWarshall
+//  Description:    Blocked Floyd-Warshall. For each diagonal block it
+//                  first solves the block itself, then the blocks in
+//                  its row and column, then everything else, so each
+//                  pass works on three cache sized blocks at a time.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void DistanceOracle<NodeType, ArcType>::floydWarshall()
+{
+	int blocks = (m_size + blockSize() - 1) / blockSize();
+	for (int k = 0; k < blocks; k++)
+	{
+		relaxBlock(k, k, k);
+		for (int b = 0; b < blocks; b++)
+		{
+			if (b != k)
+			{
+				relaxBlock(k, k, b);
+				relaxBlock(k, b, k);
+			}
+		}
+		for (int i = 0; i < blocks; i++)
+		{
+			for (int j = 0; j < blocks; j++)
+			{
+				if (i != k && j != k)
+				{
+					relaxBlock(k, i, j);
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           repeatedSearch
+//  Description:    Fills each row with a uniform cost search from its
+//                  node. The next hop to a node is found by walking
+//                  its search tree back towards the start, and is
+//                  shared by everything further down that branch.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void DistanceOracle<NodeType, ArcType>::repeatedSearch()
+{
+	IndexedGraph<NodeType, ArcType> graph(m_graph);
+	IndexedSearchSpace<ArcType> space;
+	std::vector<int> branch;
+
+	for (int from = 0; from < m_size; from++)
+	{
+		if (m_graph.nodeArray()[from] == 0)
+		{
+			continue;
+		}
+		graph.ucs(from, space);
+
+		// the direct arcs put in by rebuild() are not always the best hop.
+		int* next = &m_next[from * m_size];
+		std::fill(next, next + m_size, -1);
+		next[from] = from;
+		for (int to = 0; to < m_size; to++)
+		{
+			if (to == from || !space.reached(to) || next[to] != -1)
+			{
+				continue;
+			}
+			// walk up the tree until a node whose hop is known.
+			branch.clear();
+			int node = to;
+			while (next[node] == -1 && (int)space.prev(node) != from)
+			{
+				branch.push_back(node);
+				node = space.prev(node);
+			}
+			int hop = (next[node] == -1) ? node : next[node];
+			next[node] = hop;
+			for (size_t i = 0; i < branch.size(); i++)
+			{
+				next[branch[i]] = hop;
+			}
+		}
+		for (int to = 0; to < m_size; to++)
+		{
+			if (space.reached(to))
+			{
+				m_dist[from * m_size + to] = space.costDist(to);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           path
+//  Description:    Follows the next hop matrix from one node to the
+//                  other.
+//  Arguments:      The two node indices and the vector the path is
+//                  written to, goal first like Graph::aStar.
+//  Return Value:   false if there is no path.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool DistanceOracle<NodeType, ArcType>::path(int from, int to, std::vector<Node*>& path)
+{
+	if (nextHop(from, to) == -1)
+	{
+		return false;
+	}
+
+	size_t first = path.size();
+	for (int node = from; node != to; node = m_next[node * m_size + to])
+	{
+		path.push_back(m_graph.nodeArray()[node]);
+	}
+	path.push_back(m_graph.nodeArray()[to]);
+	std::reverse(path.begin() + first, path.end());
+	return true;
+}
+
+#endif
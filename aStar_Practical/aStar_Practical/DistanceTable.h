@@ -0,0 +1,242 @@
+#ifndef DISTANCETABLE_H
+#define DISTANCETABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           DistanceTable
+//  Description:    A dense matrix of shortest path costs from a set
+//                  of sources (rows) to a set of targets (columns).
+//                  Unreachable pairs hold unreachable(). If the table
+//                  was built with paths kept, path() can rebuild the
+//                  route for any pair from the stored search trees.
+// ----------------------------------------------------------------
+template<class ArcType>
+class DistanceTable {
+private:
+	std::vector<NodeId> m_sources;
+	std::vector<NodeId> m_targets;
+	std::vector<ArcType> m_cost;
+
+// ----------------------------------------------------------------
+//  Description:    One search tree per search that was run, or none
+//                  if paths were not kept. When m_backward is set the
+//                  searches ran from the targets over the reversed
+//                  graph, so there is one tree per column and each
+//                  entry is the next node towards that target rather
+//                  than the previous node from a source.
+// ----------------------------------------------------------------
+	std::vector<std::vector<NodeId> > m_trees;
+	bool m_backward;
+
+public:
+	static ArcType unreachable()
+	{
+		return numeric_limits<ArcType>::max();
+	}
+
+	DistanceTable(std::vector<NodeId> const & sources, std::vector<NodeId> const & targets, bool backward)
+		: m_sources(sources), m_targets(targets), m_cost(sources.size() * targets.size(), unreachable()),
+		m_backward(backward)
+	{
+	}
+
+	int rows() const
+	{
+		return (int)m_sources.size();
+	}
+
+	int cols() const
+	{
+		return (int)m_targets.size();
+	}
+
+	NodeId source(int row) const
+	{
+		return m_sources[row];
+	}
+
+	NodeId target(int col) const
+	{
+		return m_targets[col];
+	}
+
+	bool backward() const
+	{
+		return m_backward;
+	}
+
+	ArcType cost(int row, int col) const
+	{
+		return m_cost[row * m_targets.size() + col];
+	}
+
+	void setCost(int row, int col, ArcType cost)
+	{
+		m_cost[row * m_targets.size() + col] = cost;
+	}
+
+	bool hasPaths() const
+	{
+		return !m_trees.empty();
+	}
+
+	// Makes room for one search tree per search (rows, or columns when
+	// the table was built backwards).
+	void keepPaths(NodeId nodes)
+	{
+		m_trees.assign(m_backward ? cols() : rows(), std::vector<NodeId>());
+		for (size_t i = 0; i < m_trees.size(); i++)
+		{
+			m_trees[i].assign(nodes, invalidNodeId());
+		}
+	}
+
+	std::vector<NodeId>& tree(int search)
+	{
+		return m_trees[search];
+	}
+
+// ----------------------------------------------------------------
+//  Name:           path
+//  Description:    Rebuilds the path for one pair.
+//  Arguments:      The row and column, and the vector the path is
+//                  written to, goal first like Graph::aStar.
+//  Return Value:   false if paths were not kept or the pair is not
+//                  connected.
+// ----------------------------------------------------------------
+	bool path(int row, int col, std::vector<NodeId>& path) const
+	{
+		if (!hasPaths() || cost(row, col) == unreachable())
+		{
+			return false;
+		}
+
+		NodeId source = m_sources[row];
+		NodeId target = m_targets[col];
+		if (m_backward)
+		{
+			std::vector<NodeId> const & next = m_trees[col];
+			size_t first = path.size();
+			for (NodeId node = source; node != invalidNodeId(); node = next[node])
+			{
+				path.push_back(node);
+			}
+			std::reverse(path.begin() + first, path.end());
+		}
+		else
+		{
+			std::vector<NodeId> const & prev = m_trees[row];
+			for (NodeId node = target; node != invalidNodeId(); node = prev[node])
+			{
+				path.push_back(node);
+			}
+		}
+		return true;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           oneToMany
+//  Description:    Costs from one source to many targets with a
+//                  single uniform cost search that stops once every
+//                  target is settled.
+//  Arguments:      The graph, the source, the targets and the search
+//                  space to use. The costs are written to the array,
+//                  one per target.
+//  Return Value:   The number of distinct targets reached.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+int oneToMany(IndexedGraph<NodeType, ArcType> const & graph, NodeId source, std::vector<NodeId> const & targets,
+	IndexedSearchSpace<ArcType>& space, ArcType* costs)
+{
+	int reached = graph.ucs(source, targets, space);
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		costs[i] = space.costDist(targets[i]);
+	}
+	return reached;
+}
+
+// ----------------------------------------------------------------
+//  Name:           manyToMany
+//  Description:    Builds the full cost table. Each search covers a
+//                  whole row (or column), so the work for one source
+//                  is shared by all of its targets. When there are
+//                  more sources than targets the searches run from
+//                  the targets over the reversed graph instead, so
+//                  the number of searches is min(rows, cols). The
+//                  searches are shared out between worker threads,
+//                  each with its own search space.
+//  Arguments:      The graph, the sources and targets, the number of
+//                  threads to use and whether to keep the search
+//                  trees so that paths can be extracted.
+//  Return Value:   The table.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+DistanceTable<ArcType> manyToMany(IndexedGraph<NodeType, ArcType> const & graph, std::vector<NodeId> const & sources,
+	std::vector<NodeId> const & targets, int threads, bool keepPaths)
+{
+	bool backward = sources.size() > targets.size();
+	DistanceTable<ArcType> table(sources, targets, backward);
+	if (keepPaths)
+	{
+		table.keepPaths(graph.nodeCount());
+	}
+
+	IndexedGraph<NodeType, ArcType> reverse(0);
+	if (backward)
+	{
+		reverse = graph.reversed();
+	}
+	IndexedGraph<NodeType, ArcType> const & searched = backward ? reverse : graph;
+	std::vector<NodeId> const & from = backward ? targets : sources;
+	std::vector<NodeId> const & to = backward ? sources : targets;
+
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < std::max(threads, 1); t++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			IndexedSearchSpace<ArcType> space;
+			std::vector<ArcType> costs(to.size());
+			for (int search = next++; search < (int)from.size(); search = next++)
+			{
+				oneToMany(searched, from[search], to, space, costs.empty() ? 0 : &costs[0]);
+				for (size_t i = 0; i < to.size(); i++)
+				{
+					if (backward)
+					{
+						table.setCost((int)i, search, costs[i]);
+					}
+					else
+					{
+						table.setCost(search, (int)i, costs[i]);
+					}
+				}
+				if (keepPaths)
+				{
+					std::vector<NodeId>& tree = table.tree(search);
+					for (NodeId n = 0; n < searched.nodeCount(); n++)
+					{
+						tree[n] = space.prev(n);
+					}
+				}
+			}
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+	return table;
+}
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "Graph.h"
+
+// ----------------------------------------------------------------
+//  Name:           FlowField
+//  Description:    The best next node and the cost to go from every
+//                  node in the graph to one shared goal, found with a
+//                  single uniform cost search backwards from the goal.
+//                  Any number of agents heading for the goal can then
+//                  walk the next hops without searching at all.
+//                  The field listens to the graph and repairs itself
+//                  when arcs change: a new arc can only lower costs,
+//                  so the search carries on from its start node; a
+//                  removed arc on the field invalidates the branch
+//                  that used it, and only that branch is searched
+//                  again.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class FlowField : public Graph<NodeType, ArcType>::Listener {
+private:
+	typedef GraphArc<NodeType, ArcType> Arc;
+	typedef GraphNode<NodeType, ArcType> Node;
+	typedef std::pair<int, ArcType> InArc;
+
+	struct OpenEntry {
+		ArcType costDist;
+		int node;
+
+		bool operator>(OpenEntry const & other) const
+		{
+			return costDist > other.costDist;
+		}
+	};
+	typedef std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > OpenList;
+
+	Graph<NodeType, ArcType>& m_graph;
+	int m_goal;
+
+	std::vector<ArcType> m_costToGo;
+	std::vector<int> m_next;
+
+// ----------------------------------------------------------------
+//  Description:    The arcs into each node (source and weight), as
+//                  the graph itself only stores arcs going out.
+// ----------------------------------------------------------------
+	std::vector<std::vector<InArc> > m_in;
+
+	FlowField(FlowField const &);
+	FlowField& operator=(FlowField const &);
+
+	void grow(int nodes)
+	{
+		if ((int)m_next.size() < nodes)
+		{
+			m_costToGo.resize(nodes, unreachable());
+			m_next.resize(nodes, -1);
+			m_in.resize(nodes);
+		}
+	}
+
+	void push(OpenList& open, int node)
+	{
+		OpenEntry entry = { m_costToGo[node], node };
+		open.push(entry);
+	}
+
+	void propagate(OpenList& open);
+	void invalidateBranch(int root, std::vector<int>& branch);
+
+public:
+	static ArcType unreachable()
+	{
+		return numeric_limits<ArcType>::max();
+	}
+
+	FlowField(Graph<NodeType, ArcType>& graph, Node* pGoal);
+	~FlowField();
+
+	void rebuild();
+
+	Node* goal() const
+	{
+		return m_graph.nodeArray()[m_goal];
+	}
+
+	ArcType costToGo(int index) const
+	{
+		return m_costToGo[index];
+	}
+
+	// The node to move to next from the given node, or -1 at the goal
+	// or if the goal cannot be reached.
+	int next(int index) const
+	{
+		return m_next[index];
+	}
+
+	bool path(Node* pFrom, std::vector<Node*>& path) const;
+
+	// Graph::Listener
+	void nodeAdded(int index);
+	void nodeRemoved(int index);
+	void arcAdded(int from, int to, ArcType weight);
+	void arcRemoved(int from, int to);
+};
+
+template<class NodeType, class ArcType>
+FlowField<NodeType, ArcType>::FlowField(Graph<NodeType, ArcType>& graph, Node* pGoal)
+	: m_graph(graph), m_goal(pGoal->index())
+{
+	rebuild();
+	m_graph.addListener(this);
+}
+
+template<class NodeType, class ArcType>
+FlowField<NodeType, ArcType>::~FlowField()
+{
+	m_graph.removeListener(this);
+}
+
+// ----------------------------------------------------------------
+//  Name:           propagate
+//  Description:    Uniform cost search over the incoming arcs from
+//                  whatever nodes are already on the open list.
+//  Arguments:      The open list.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::propagate(OpenList& open)
+{
+	while (!open.empty())
+	{
+		OpenEntry top = open.top();
+		open.pop();
+		if (top.costDist != m_costToGo[top.node])
+		{
+			continue;
+		}
+
+		std::vector<InArc> const & in = m_in[top.node];
+		for (size_t i = 0; i < in.size(); i++)
+		{
+			int from = in[i].first;
+			ArcType dist = top.costDist + in[i].second;
+			if (dist < m_costToGo[from])
+			{
+				m_costToGo[from] = dist;
+				m_next[from] = top.node;
+				push(open, from);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           rebuild
+//  Description:    Builds the incoming arc lists and the whole field
+//                  from scratch.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::rebuild()
+{
+	int size = m_graph.maxNodes();
+	m_costToGo.assign(size, unreachable());
+	m_next.assign(size, -1);
+	m_in.assign(size, std::vector<InArc>());
+
+	for (int from = 0; from < size; from++)
+	{
+		Node* pNode = m_graph.nodeArray()[from];
+		if (pNode != 0)
+		{
+			typename list<Arc>::const_iterator iter = pNode->arcList().begin();
+			for (; iter != pNode->arcList().end(); ++iter)
+			{
+				m_in[(*iter).node()->index()].push_back(InArc(from, (*iter).weight()));
+			}
+		}
+	}
+
+	if (m_graph.nodeArray()[m_goal] != 0)
+	{
+		OpenList open;
+		m_costToGo[m_goal] = 0;
+		push(open, m_goal);
+		propagate(open);
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           invalidateBranch
+//  Description:    Clears every node whose next hops pass through
+//                  the root, including the root itself.
+//  Arguments:      The root and the vector the cleared nodes are
+//                  written to.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::invalidateBranch(int root, std::vector<int>& branch)
+{
+	std::vector<int> stack(1, root);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+		branch.push_back(node);
+
+		// the nodes that step onto this one are in the branch too.
+		std::vector<InArc> const & in = m_in[node];
+		for (size_t i = 0; i < in.size(); i++)
+		{
+			if (m_next[in[i].first] == node)
+			{
+				stack.push_back(in[i].first);
+				m_next[in[i].first] = -1;
+			}
+		}
+		m_costToGo[node] = unreachable();
+		m_next[node] = -1;
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           path
+//  Description:    Follows the next hops from a node to the goal.
+//  Arguments:      The node to start from and the vector the path is
+//                  written to, goal first like Graph::aStar.
+//  Return Value:   false if the goal cannot be reached.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool FlowField<NodeType, ArcType>::path(Node* pFrom, std::vector<Node*>& path) const
+{
+	int node = pFrom->index();
+	if (m_costToGo[node] == unreachable())
+	{
+		return false;
+	}
+
+	size_t first = path.size();
+	for (; node != -1; node = m_next[node])
+	{
+		path.push_back(m_graph.nodeArray()[node]);
+	}
+	std::reverse(path.begin() + first, path.end());
+	return true;
+}
+
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::nodeAdded(int index)
+{
+	grow(m_graph.maxNodes());
+
+	// the goal coming back is a new seed; arcs into it follow through
+	// arcAdded and spread from there.
+	if (index == m_goal)
+	{
+		OpenList open;
+		m_costToGo[m_goal] = 0;
+		m_next[m_goal] = -1;
+		push(open, m_goal);
+		propagate(open);
+	}
+}
+
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::nodeRemoved(int index)
+{
+	// the arcs into the node have already gone through arcRemoved, so
+	// nothing steps onto it any more; its own arcs go with it.
+	Node* pNode = m_graph.nodeArray()[index];
+	typename list<Arc>::const_iterator iter = pNode->arcList().begin();
+	for (; iter != pNode->arcList().end(); ++iter)
+	{
+		std::vector<InArc>& in = m_in[(*iter).node()->index()];
+		for (size_t i = 0; i < in.size(); i++)
+		{
+			if (in[i].first == index)
+			{
+				in.erase(in.begin() + i);
+				break;
+			}
+		}
+	}
+	m_costToGo[index] = unreachable();
+	m_next[index] = -1;
+
+	// with the goal gone nothing can reach it.
+	if (index == m_goal)
+	{
+		std::fill(m_costToGo.begin(), m_costToGo.end(), unreachable());
+		std::fill(m_next.begin(), m_next.end(), -1);
+	}
+}
+
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::arcAdded(int from, int to, ArcType weight)
+{
+	m_in[to].push_back(InArc(from, weight));
+	if (m_costToGo[to] != unreachable() && m_costToGo[to] + weight < m_costToGo[from])
+	{
+		OpenList open;
+		m_costToGo[from] = m_costToGo[to] + weight;
+		m_next[from] = to;
+		push(open, from);
+		propagate(open);
+	}
+}
+
+template<class NodeType, class ArcType>
+void FlowField<NodeType, ArcType>::arcRemoved(int from, int to)
+{
+	std::vector<InArc>& in = m_in[to];
+	for (size_t i = 0; i < in.size(); i++)
+	{
+		if (in[i].first == from)
+		{
+			in.erase(in.begin() + i);
+			break;
+		}
+	}
+	if (m_next[from] != to)
+	{
+		return;
+	}
+
+	// the branch hanging off the removed arc has to find new routes,
+	// either through an arc leaving the branch or not at all.
+	std::vector<int> branch;
+	invalidateBranch(from, branch);
+
+	OpenList open;
+	for (size_t b = 0; b < branch.size(); b++)
+	{
+		int node = branch[b];
+		typename list<Arc>::const_iterator iter = m_graph.nodeArray()[node]->arcList().begin();
+		for (; iter != m_graph.nodeArray()[node]->arcList().end(); ++iter)
+		{
+			int hop = (*iter).node()->index();
+			if (m_costToGo[hop] != unreachable() && m_costToGo[hop] + (*iter).weight() < m_costToGo[node])
+			{
+				m_costToGo[node] = m_costToGo[hop] + (*iter).weight();
+				m_next[node] = hop;
+			}
+		}
+		if (m_costToGo[node] != unreachable())
+		{
+			push(open, node);
+		}
+	}
+	propagate(open);
+}
+
+#endif
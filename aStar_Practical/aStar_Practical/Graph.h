@@ -1,10 +1,13 @@
  #ifndef GRAPH_H
 #define GRAPH_H
 
-#include "SFML/Graphics.hpp" 
-#include "SFML/OpenGL.hpp" 
+#include <algorithm>
 #include <list>
 #include <queue>
+#include <vector>
+
+#include "GraphPosition.h"
+#include "HeuristicScale.h"
 
 using namespace std;
 
@@ -39,6 +42,38 @@ private:
 // ----------------------------------------------------------------
     int m_count;
 
+// ----------------------------------------------------------------
+//  Description:    Weight per unit of distance used to turn the
+//                  straight line distance to the goal into the A*
+//                  estimate, and whether an edit since it was worked
+//                  out means it must be worked out again.
+// ----------------------------------------------------------------
+    float m_heuristicScale;
+    bool m_scaleStale;
+
+public:
+// ----------------------------------------------------------------
+//  Name:           Listener
+//  Description:    Told about every edit made to the graph, so that
+//                  structures built from it can bring themselves up
+//                  to date. nodeRemoved() is called before the node
+//                  is deleted, while its arcs can still be read.
+// ----------------------------------------------------------------
+	struct Listener {
+	public:
+		virtual ~Listener() {}
+		virtual void nodeAdded(int index) {}
+		virtual void nodeRemoved(int index) {}
+		virtual void arcAdded(int from, int to, ArcType weight) {}
+		virtual void arcRemoved(int from, int to) {}
+	};
+
+private:
+// ----------------------------------------------------------------
+//  Description:    The listeners to tell about edits.
+// ----------------------------------------------------------------
+    std::vector<Listener*> m_listeners;
+
 public:           
     // Constructor and destructor functions
     Graph( int size );
@@ -50,8 +85,59 @@ public:
        return m_pNodes;
     }
 
+	int maxNodes() const
+	{
+		return m_maxNodes;
+	}
+
+	int count() const
+	{
+		return m_count;
+	}
+
+	void addListener(Listener* pListener)
+	{
+		m_listeners.push_back(pListener);
+	}
+
+	void removeListener(Listener* pListener)
+	{
+		m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), pListener), m_listeners.end());
+	}
+
+	// The scale aStar uses, calibrated first if the graph has changed.
+	float heuristicScale()
+	{
+		if (m_scaleStale)
+		{
+			calibrateHeuristic();
+		}
+		return m_heuristicScale;
+	}
+
+	// Overrides the calibrated scale until the graph is next edited.
+	void setHeuristicScale(float scale)
+	{
+		m_heuristicScale = scale;
+		m_scaleStale = false;
+	}
+
+// ----------------------------------------------------------------
+//  Name:           SearchObserver
+//  Description:    Lets a caller follow a search while it runs.
+//                  expanded() is called for every node taken off
+//                  the queue and cancelled() is polled before each
+//                  expansion so a search can be abandoned early.
+// ----------------------------------------------------------------
+	struct SearchObserver {
+	public:
+		virtual ~SearchObserver() {}
+		virtual void expanded(Node * pNode) {}
+		virtual bool cancelled() { return false; }
+	};
+
     // Public member functions.
-    bool addNode( NodeType data, sf::Vector2f pos, int index );
+    bool addNode( NodeType data, GraphPosition pos, int index );
     void removeNode( int index );
     bool addArc( int from, int to, ArcType weight );
     void removeArc( int from, int to );
@@ -60,8 +146,11 @@ public:
     void depthFirst( Node* pNode, void (*pProcess)(Node*) );
     void breadthFirst( Node* pNode, void (*pProcess)(Node*) );
 	void advbreadthFirst(Node* pNode, Node* goal, void(*pProcess)(Node*));
+	float calibrateHeuristic();
+	int validateHeuristic(float scale, std::vector<HeuristicViolation<ArcType> >& violations) const;
 	void ucs(Node* pStart, Node* pDest, void(*pVisitFunc)(Node*), std::vector<Node *>& path);
 	void aStar(Node* pStart, Node* pDest, void(*pProcess)(Node*), std::vector<Node *> & path);
+	bool aStar(Node* pStart, Node* pDest, SearchObserver& observer, std::vector<Node *> & path);
 
 	struct UCSCostCompare{
 	public:
@@ -85,7 +174,7 @@ public:
 //  Return Value:   None.
 // ----------------------------------------------------------------
 template<class NodeType, class ArcType>
-Graph<NodeType, ArcType>::Graph( int size ) : m_maxNodes( size ) {
+Graph<NodeType, ArcType>::Graph( int size ) : m_maxNodes( size ), m_heuristicScale( 1 ), m_scaleStale( true ) {
    int i;
    m_pNodes = new Node * [m_maxNodes];
    // go through every index and clear it to null (0)
@@ -123,7 +212,7 @@ Graph<NodeType, ArcType>::~Graph() {
 //  Return Value:   true if successful
 // ----------------------------------------------------------------
 template<class NodeType, class ArcType>
-bool Graph<NodeType, ArcType>::addNode(NodeType data, sf::Vector2f pos, int index) {
+bool Graph<NodeType, ArcType>::addNode(NodeType data, GraphPosition pos, int index) {
    bool nodeNotPresent = false;
    // find out if a node does not exist at that index.
    if ( m_pNodes[index] == 0) {
@@ -132,9 +221,13 @@ bool Graph<NodeType, ArcType>::addNode(NodeType data, sf::Vector2f pos, int inde
       m_pNodes[index] = new Node;
       m_pNodes[index]->setData(data);
 	  m_pNodes[index]->setPos(pos);
+	  m_pNodes[index]->setIndex(index);
       m_pNodes[index]->setMarked(false);
       // increase the count and return success.
       m_count++;
+      for (size_t i = 0; i < m_listeners.size(); i++) {
+          m_listeners[i]->nodeAdded(index);
+      }
     }
         
     return nodeNotPresent;
@@ -172,7 +265,11 @@ void Graph<NodeType, ArcType>::removeNode( int index ) {
 
         // now that every arc pointing to the current node has been removed,
         // the node can be deleted.
+        for (size_t i = 0; i < m_listeners.size(); i++) {
+            m_listeners[i]->nodeRemoved(index);
+        }
         delete m_pNodes[index];
+        m_scaleStale = true;
         m_pNodes[index] = 0;
         m_count--;
     }
@@ -203,6 +300,10 @@ bool Graph<NodeType, ArcType>::addArc( int from, int to, ArcType weight ) {
      if (proceed == true) {
         // add the arc to the "from" node.
         m_pNodes[from]->addArc( m_pNodes[to], weight );
+        m_scaleStale = true;
+        for (size_t i = 0; i < m_listeners.size(); i++) {
+            m_listeners[i]->arcAdded(from, to, weight);
+        }
      }
         
      return proceed;
@@ -224,9 +325,13 @@ void Graph<NodeType, ArcType>::removeArc( int from, int to ) {
          nodeExists = false;
      }
 
-     if (nodeExists == true) {
+     if (nodeExists == true && m_pNodes[from]->getArc( m_pNodes[to] ) != 0) {
         // remove the arc.
         m_pNodes[from]->removeArc( m_pNodes[to] );
+        m_scaleStale = true;
+        for (size_t i = 0; i < m_listeners.size(); i++) {
+            m_listeners[i]->arcRemoved(from, to);
+        }
      }
 }
 
@@ -243,15 +348,10 @@ template<class NodeType, class ArcType>
 GraphArc<NodeType, ArcType>* Graph<NodeType, ArcType>::getArc( int from, int to )
 {
      Arc* pArc = 0;
-	 list<Arc>::iterator iter = m_arcList.begin();
-
-	 // find the arc that matches the node
-	 for (; iter != endIter && pArc == 0; ++iter) 
-	 {
-		 if ((*iter).node() == pNode) {
-			 pArc = &((*iter));
-		 }
-	 }
+     // find the arc through the "from" node, if both nodes exist.
+     if( m_pNodes[from] != 0 && m_pNodes[to] != 0 ) {
+         pArc = m_pNodes[from]->getArc( m_pNodes[to] );
+     }
 
 	 // returns null if not found
 	 return pArc;
@@ -290,8 +390,8 @@ void Graph<NodeType, ArcType>::depthFirst( Node* pNode, void (*pProcess)(Node*)
            pNode->setMarked(true);
 
            // go through each connecting node
-           list<Arc>::iterator iter = pNode->arcList().begin();
-           list<Arc>::iterator endIter = pNode->arcList().end();
+           typename list<Arc>::iterator iter = pNode->arcList().begin();
+           typename list<Arc>::iterator endIter = pNode->arcList().end();
         
 		   for( ; iter != endIter; ++iter) {
 			    // process the linked node if it isn't already marked.
@@ -328,8 +428,8 @@ void Graph<NodeType, ArcType>::breadthFirst( Node* pNode, void (*pProcess)(Node*
 
 			// add all of the child nodes that have not been 
 			// marked into the queue
-			list<Arc>::const_iterator iter = nodeQueue.front()->arcList().begin();
-			list<Arc>::const_iterator endIter = nodeQueue.front()->arcList().end();
+			typename list<Arc>::const_iterator iter = nodeQueue.front()->arcList().begin();
+			typename list<Arc>::const_iterator endIter = nodeQueue.front()->arcList().end();
 
 			for (; iter != endIter; iter++)
 			{
@@ -371,8 +471,8 @@ void Graph<NodeType, ArcType>::advbreadthFirst(Node* pNode, Node* goal, void(*pP
 		while (nodeQueue.size() != 0 && goalReached == false)
 		{	
 			//pProcess(nodeQueue.front());
-			list<Arc>::const_iterator iter = nodeQueue.front()->arcList().begin();
-			list<Arc>::const_iterator endIter = nodeQueue.front()->arcList().end();
+			typename list<Arc>::const_iterator iter = nodeQueue.front()->arcList().begin();
+			typename list<Arc>::const_iterator endIter = nodeQueue.front()->arcList().end();
 			
 			for (; iter != endIter; iter++)
 			{
@@ -404,6 +504,76 @@ void Graph<NodeType, ArcType>::advbreadthFirst(Node* pNode, Node* goal, void(*pP
 }
 
 
+// ----------------------------------------------------------------
+//  Name:           calibrateHeuristic
+//  Description:    Works out the largest scale of distance to arc
+//                  weight that keeps the A* estimate consistent (see
+//                  HeuristicCalibration) from every arc in the graph.
+//                  aStar calls it itself after the graph is edited;
+//                  moving a node with setPos() does not count as an
+//                  edit, so call it after doing that.
+//  Arguments:      None.
+//  Return Value:   The scale, which aStar now uses.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+float Graph<NodeType, ArcType>::calibrateHeuristic()
+{
+	HeuristicCalibration calibration;
+	for (int i = 0; i < m_maxNodes; i++)
+	{
+		if (m_pNodes[i] == 0)
+		{
+			continue;
+		}
+		typename list<Arc>::const_iterator arc = m_pNodes[i]->arcList().begin();
+		for (; arc != m_pNodes[i]->arcList().end(); arc++)
+		{
+			calibration.addArc(m_pNodes[i]->getPos(), (*arc).node()->getPos(), (*arc).weight());
+		}
+	}
+	m_heuristicScale = calibration.scale();
+	m_scaleStale = false;
+	return m_heuristicScale;
+}
+
+// ----------------------------------------------------------------
+//  Name:           validateHeuristic
+//  Description:    Checks every arc against a scale, for trying out
+//                  a scale of your own (or the weights of a new map)
+//                  before handing it to setHeuristicScale(). An arc
+//                  is reported if the estimate falls by more than its
+//                  weight along it, which would let A* close a node
+//                  before finding its cheapest path.
+//  Arguments:      The scale and the vector the arcs that break
+//                  consistency are added to.
+//  Return Value:   The number of arcs added.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+int Graph<NodeType, ArcType>::validateHeuristic(float scale, std::vector<HeuristicViolation<ArcType> >& violations) const
+{
+	int found = 0;
+	for (int i = 0; i < m_maxNodes; i++)
+	{
+		if (m_pNodes[i] == 0)
+		{
+			continue;
+		}
+		typename list<Arc>::const_iterator arc = m_pNodes[i]->arcList().begin();
+		for (; arc != m_pNodes[i]->arcList().end(); arc++)
+		{
+			GraphPosition from = m_pNodes[i]->getPos();
+			GraphPosition to = (*arc).node()->getPos();
+			if (HeuristicCalibration::violates(from, to, (*arc).weight(), scale))
+			{
+				HeuristicViolation<ArcType> violation = { i, (*arc).node()->index(), (*arc).weight(), scale * HeuristicCalibration::length(from, to) };
+				violations.push_back(violation);
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
 template<class NodeType, class ArcType>
 void Graph<NodeType, ArcType>::ucs(Node* pStart, Node* pDest, void(*pVisitFunc)(Node*), std::vector<Node *>& path)
 {
@@ -449,8 +619,8 @@ void Graph<NodeType, ArcType>::ucs(Node* pStart, Node* pDest, void(*pVisitFunc)(
 	while (pq.empty() == false && pq.top() != g)//While the queue is not empty AND pq.top() != g
 	{
 		//For each child node c of pq.top()
-		list<Arc>::const_iterator child = pq.top()->arcList().begin();
-		list<Arc>::const_iterator endchild = pq.top()->arcList().end();
+		typename list<Arc>::const_iterator child = pq.top()->arcList().begin();
+		typename list<Arc>::const_iterator endchild = pq.top()->arcList().end();
 		for (; child != endchild; child++)//iterate through arcs
 		{
 			if ((*child).node() != pq.top()->getPrevNode())
@@ -460,7 +630,6 @@ void Graph<NodeType, ArcType>::ucs(Node* pStart, Node* pDest, void(*pVisitFunc)(
 				if (dist < (*child).node()->getCostDist()) //If ( distC < distanceCost[c] )
 				{
 					(*child).node()->setCostDist(dist);//let distanceCost[c] = distC
-					(*child).node()->setEstGoalDist(dist * 0.9f);
 					(*child).node()->setPrevNode(pq.top());//Set previous pointer of c to pq.top()
 				}
 				if (!(*child).node()->marked())//If(notMarked(c))
@@ -482,8 +651,45 @@ void Graph<NodeType, ArcType>::ucs(Node* pStart, Node* pDest, void(*pVisitFunc)(
 	
 }
 
+// ----------------------------------------------------------------
+//  Name:           ProcessObserver
+//  Description:    Adapts a plain processing function to the
+//                  SearchObserver hooks used by aStar.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class ProcessObserver : public Graph<NodeType, ArcType>::SearchObserver {
+private:
+	void(*m_pProcess)(GraphNode<NodeType, ArcType>*);
+public:
+	ProcessObserver(void(*pProcess)(GraphNode<NodeType, ArcType>*)) : m_pProcess(pProcess) {}
+
+	void expanded(GraphNode<NodeType, ArcType>* pNode)
+	{
+		if (m_pProcess != 0)
+		{
+			m_pProcess(pNode);
+		}
+	}
+};
+
 template<class NodeType, class ArcType>
 void Graph<NodeType, ArcType>::aStar(Node* pStart, Node* pDest, void(*pProcess)(Node*), std::vector<Node *> & path)
+{
+	ProcessObserver<NodeType, ArcType> observer(pProcess);
+	aStar(pStart, pDest, observer, path);
+}
+
+// ----------------------------------------------------------------
+//  Name:           aStar
+//  Description:    A* search from the start node to the destination.
+//  Arguments:      The start and destination nodes, the observer
+//                  told about each expansion, and the vector the
+//                  path is written to (goal first).
+//  Return Value:   false if the observer cancelled the search, in
+//                  which case no path is written.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool Graph<NodeType, ArcType>::aStar(Node* pStart, Node* pDest, SearchObserver& observer, std::vector<Node *> & path)
 {
 	/*
 	Let s = the starting node, g = goal node
@@ -516,6 +722,7 @@ void Graph<NodeType, ArcType>::aStar(Node* pStart, Node* pDest, void(*pProcess)(
 	Node * g = pDest;//Let g = goal node
 	priority_queue<Node*, vector<Node *>, AStarCostCompare> pq;//Let pq = a new priority queue
 	vector<Node *> newNodes;
+	float scale = heuristicScale();
 	s->setCostDist(0);//Initialise distanceCost[s] to 0// d == setting distance cost
 
 	for (int i = 0; i < m_count; i++)//For each node v in graph G
@@ -527,7 +734,7 @@ void Graph<NodeType, ArcType>::aStar(Node* pStart, Node* pDest, void(*pProcess)(
 			
 			m_pNodes[i]->setPrevNode(nullptr);
 			m_pNodes[i]->setMarked(false);
-			m_pNodes[i]->setEstGoalDist(sqrt(x2 + y2));//calculating y
+			m_pNodes[i]->setEstGoalDist(scale * sqrt(x2 + y2));//calculating y, in arc weight units
 			m_pNodes[i]->setCostDist(9999999);//Initialise distanceCost[TotalNodes] to infinity // dont yet know the distances to these nodes
 		}
 	}
@@ -535,13 +742,18 @@ void Graph<NodeType, ArcType>::aStar(Node* pStart, Node* pDest, void(*pProcess)(
 	s->setMarked(true);//Mark(s)
 	while (pq.empty() == false && pq.top() != g)//While the queue is not empty AND pq.top() != g
 	{
+		if (observer.cancelled())
+		{
+			return false;
+		}
+
 		Node * currNode = pq.top();
 		pq.pop();
 
-		pProcess(currNode);
+		observer.expanded(currNode);
 		//For each child node c of pq.top()
-		list<Arc>::const_iterator child = currNode->arcList().begin();
-		list<Arc>::const_iterator endchild = currNode->arcList().end();
+		typename list<Arc>::const_iterator child = currNode->arcList().begin();
+		typename list<Arc>::const_iterator endchild = currNode->arcList().end();
 		for (; child != endchild; child++)//iterate through arcs
 		{
 			if ((*child).node() != currNode->getPrevNode())
@@ -584,6 +796,7 @@ void Graph<NodeType, ArcType>::aStar(Node* pStart, Node* pDest, void(*pProcess)(
 		path.push_back(node);
 		node = node->getPrevNode();//gets next previous node
 	}
+	return true;
 }
 
 #include "GraphNode.h"
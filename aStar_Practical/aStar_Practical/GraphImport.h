@@ -0,0 +1,731 @@
+#ifndef GRAPHIMPORT_H
+#define GRAPHIMPORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IndexedGraph.h"
+#include "MappedFile.h"
+
+// ----------------------------------------------------------------
+//  Input layouts GraphImporter reads. Arc files give "from to weight"
+//  and position files "id x y", in the form below; IMPORT_AUTO goes
+//  by the file name (.gr and .co are DIMACS, .csv is CSV, anything
+//  else an edge list).
+//  IMPORT_DIMACS       The 9th DIMACS challenge files: "a u v w" arcs
+//                      in .gr and "v id x y" coordinates in .co, ids
+//                      from 1, "c" comments and a "p" line giving the
+//                      node count.
+//  IMPORT_EDGE_LIST    Whitespace separated, ids from 0, the weight
+//                      optional (1 if left out), "#" or "%" comments.
+//  IMPORT_CSV          The same fields separated by commas. The first
+//                      line is skipped if it is a header.
+// ----------------------------------------------------------------
+enum ImportFormat {
+	IMPORT_AUTO,
+	IMPORT_DIMACS,
+	IMPORT_EDGE_LIST,
+	IMPORT_CSV
+};
+
+// Node data from a name in a node list. Types other than strings do
+// not keep names.
+inline void importNodeData(char const * pName, unsigned int length, std::string& data)
+{
+	data.assign(pName, length);
+}
+
+template<class NodeType>
+void importNodeData(char const *, unsigned int, NodeType&)
+{
+}
+
+// ----------------------------------------------------------------
+//  Name:           ImportScanner
+//  Description:    The field parsers the importer is built from. They
+//                  work on a pointer into the mapped file and move it
+//                  past whatever they read, so nothing is copied out
+//                  of the file. Numbers are parsed by hand: the
+//                  standard stream and strtod parsers check the locale
+//                  for every character and are several times slower.
+// ----------------------------------------------------------------
+struct ImportScanner {
+	static bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static bool isDigit(char c)
+	{
+		return (unsigned char)(c - '0') < 10;
+	}
+
+	static void skipBlanks(char const *& p, char const * pEnd)
+	{
+		while (p < pEnd && isBlank(*p))
+		{
+			p++;
+		}
+	}
+
+	static void skipLine(char const *& p, char const * pEnd)
+	{
+		char const * pNewline = (char const *)memchr(p, '\n', pEnd - p);
+		p = (pNewline != 0) ? pNewline + 1 : pEnd;
+	}
+
+	// Passes the end of a line, allowing trailing blanks.
+	static bool endLine(char const *& p, char const * pEnd)
+	{
+		skipBlanks(p, pEnd);
+		if (p == pEnd)
+		{
+			return true;
+		}
+		if (*p == '\n')
+		{
+			p++;
+			return true;
+		}
+		return false;
+	}
+
+	// Passes the gap between two fields: a comma, or at least one
+	// blank.
+	static bool separator(char const *& p, char const * pEnd, bool csv)
+	{
+		char const * pStart = p;
+		skipBlanks(p, pEnd);
+		if (csv)
+		{
+			if (p == pEnd || *p != ',')
+			{
+				return false;
+			}
+			p++;
+			skipBlanks(p, pEnd);
+			return true;
+		}
+		return p > pStart && p < pEnd && *p != '\n';
+	}
+
+	static bool readId(char const *& p, char const * pEnd, unsigned long long& id)
+	{
+		if (p == pEnd || !isDigit(*p))
+		{
+			return false;
+		}
+		id = 0;
+		while (p < pEnd && isDigit(*p))
+		{
+			id = id * 10 + (*p - '0');
+			// invalidNodeId() and above are never valid.
+			if (id >= invalidNodeId())
+			{
+				return false;
+			}
+			p++;
+		}
+		return true;
+	}
+
+	// A decimal number with optional sign, fraction and exponent. The
+	// first 19 digits are exact; later ones only shift the exponent.
+	static bool readNumber(char const *& p, char const * pEnd, double& value)
+	{
+		char const * pStart = p;
+		bool negative = false;
+		if (p < pEnd && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			p++;
+		}
+		unsigned long long mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		for (; p < pEnd && isDigit(*p); p++, digits++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (p < pEnd && *p == '.')
+		{
+			for (p++; p < pEnd && isDigit(*p); p++, digits++)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					exponent--;
+				}
+			}
+		}
+		if (digits == 0)
+		{
+			p = pStart;
+			return false;
+		}
+		if (p < pEnd && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExponent = false;
+			if (p < pEnd && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = (*p == '-');
+				p++;
+			}
+			if (p == pEnd || !isDigit(*p))
+			{
+				p = pStart;
+				return false;
+			}
+			int written = 0;
+			for (; p < pEnd && isDigit(*p); p++)
+			{
+				written = std::min(written * 10 + (*p - '0'), 100000);
+			}
+			exponent += negativeExponent ? -written : written;
+		}
+
+		static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		value = (double)mantissa;
+		for (; exponent > 0 && value != 0; exponent -= std::min(exponent, 22))
+		{
+			value *= powers[std::min(exponent, 22)];
+		}
+		for (; exponent < 0 && value != 0; exponent += std::min(-exponent, 22))
+		{
+			value /= powers[std::min(-exponent, 22)];
+		}
+		value = negative ? -value : value;
+		return true;
+	}
+
+	// A run of characters up to the next blank or line end.
+	static bool readWord(char const *& p, char const * pEnd, char const *& pWord, unsigned int& length)
+	{
+		pWord = p;
+		while (p < pEnd && !isBlank(*p) && *p != '\n')
+		{
+			p++;
+		}
+		length = (unsigned int)(p - pWord);
+		return length > 0;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           GraphImporter
+//  Description:    Builds an IndexedGraph from text files at close to
+//                  disk speed. Each file is mapped rather than read,
+//                  cut into chunks at line breaks and the chunks are
+//                  parsed by a pool of threads straight into arrays
+//                  of ids, weights and positions; build() then hands
+//                  those to the graph. Node names are kept as places
+//                  in the mapping and only become node data in
+//                  build(), so the files stay mapped until then.
+//                  Call importArcs() and any of importPositions() and
+//                  importNodes(), then build(). The node count is the
+//                  one a DIMACS "p" line or a node list gives, and
+//                  arcs or positions past it are skipped; without one
+//                  it is one more than the highest id seen.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class GraphImporter {
+private:
+	struct ImportedArc {
+		NodeId from;
+		NodeId to;
+		ArcType weight;
+	};
+
+	struct ImportedNode {
+		NodeId id;
+		unsigned int nameLength;
+		char const * pName;
+		GraphPosition pos;
+	};
+
+	// What a file holds: arcs, positions by id, or named nodes whose
+	// ids are their line order.
+	enum Content {
+		ARCS,
+		POSITIONS,
+		NAMED_NODES
+	};
+
+	struct Chunk {
+		char const * pBegin;
+		char const * pEnd;
+		std::vector<ImportedArc> arcs;
+		std::vector<ImportedNode> nodes;
+		NodeId ids;
+		char const * pBad;
+	};
+
+	int m_threads;
+	std::vector<std::unique_ptr<MappedFile> > m_files;
+	std::vector<std::unique_ptr<Chunk> > m_arcChunks;
+	std::vector<std::unique_ptr<Chunk> > m_nodeChunks;
+	NodeId m_declared;
+	bool m_hasDeclared;
+	NodeId m_ids;
+	size_t m_arcs;
+	size_t m_skipped;
+	std::string m_error;
+
+	GraphImporter(GraphImporter const &);
+	GraphImporter& operator=(GraphImporter const &);
+
+	bool import(std::string const & fileName, ImportFormat format, Content content);
+	void parse(Chunk& chunk, ImportFormat format, Content content, char const * pFileStart) const;
+	bool parseLine(char const *& p, char const * pEnd, ImportFormat format, Content content, Chunk& chunk) const;
+	void readHeader(char const * p, char const * pEnd);
+
+public:
+	explicit GraphImporter(int threads)
+		: m_threads(std::max(threads, 1)), m_declared(0), m_hasDeclared(false), m_ids(0), m_arcs(0), m_skipped(0)
+	{
+	}
+
+	static ImportFormat formatOf(std::string const & fileName)
+	{
+		size_t dot = fileName.rfind('.');
+		std::string extension = (dot == std::string::npos) ? std::string() : fileName.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "gr" || extension == "co")
+		{
+			return IMPORT_DIMACS;
+		}
+		return (extension == "csv") ? IMPORT_CSV : IMPORT_EDGE_LIST;
+	}
+
+	bool importArcs(std::string const & fileName, ImportFormat format = IMPORT_AUTO)
+	{
+		return import(fileName, format, ARCS);
+	}
+
+	bool importPositions(std::string const & fileName, ImportFormat format = IMPORT_AUTO)
+	{
+		return import(fileName, format, POSITIONS);
+	}
+
+	// The visualiser's nodes file: "name x y", ids in line order.
+	bool importNodes(std::string const & fileName)
+	{
+		return import(fileName, IMPORT_EDGE_LIST, NAMED_NODES);
+	}
+
+	bool build(IndexedGraph<NodeType, ArcType>& graph);
+
+	// Why the last call failed.
+	std::string const & error() const
+	{
+		return m_error;
+	}
+
+	// Arcs and positions build() left out for naming a node past the
+	// declared count.
+	size_t skipped() const
+	{
+		return m_skipped;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           import
+//  Description:    Maps a file, cuts it into chunks that each start
+//                  at a line and parses them on the worker threads.
+//                  There are several chunks per thread so one slow
+//                  chunk does not hold the rest up, but none smaller
+//                  than a megabyte.
+//                  An empty file imports as one with no lines.
+//  Arguments:      The file, its format and what it holds.
+//  Return Value:   false if the file cannot be mapped or a line
+//                  cannot be read; error() says which.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool GraphImporter<NodeType, ArcType>::import(std::string const & fileName, ImportFormat format, Content content)
+{
+	m_error.clear();
+	std::unique_ptr<MappedFile> pFile(new MappedFile);
+	if (!pFile->open(fileName))
+	{
+		// an empty file cannot be mapped, but is a file of no lines.
+		std::ifstream file(fileName.c_str(), std::ios::binary | std::ios::ate);
+		if (!file || file.tellg() != std::streampos(0))
+		{
+			m_error = "cannot map " + fileName;
+			return false;
+		}
+	}
+	if (format == IMPORT_AUTO)
+	{
+		format = formatOf(fileName);
+	}
+	char const * pStart = pFile->data();
+	char const * pEnd = pStart + pFile->size();
+	if (format == IMPORT_DIMACS)
+	{
+		readHeader(pStart, pEnd);
+	}
+
+	const size_t minChunk = 1 << 20;
+	size_t chunks = std::max((size_t)1, std::min((size_t)m_threads * 8, pFile->size() / minChunk));
+	std::vector<std::unique_ptr<Chunk> > parsed;
+	char const * p = pStart;
+	for (size_t c = 0; c < chunks && p < pEnd; c++)
+	{
+		std::unique_ptr<Chunk> pChunk(new Chunk);
+		pChunk->pBegin = p;
+		p = (c + 1 == chunks) ? pEnd : std::max(p, pStart + pFile->size() / chunks * (c + 1));
+		if (p < pEnd)
+		{
+			ImportScanner::skipLine(p, pEnd);
+		}
+		pChunk->pEnd = p;
+		parsed.push_back(std::move(pChunk));
+	}
+
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < m_threads && t < (int)parsed.size(); t++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for (int c = next++; c < (int)parsed.size(); c = next++)
+			{
+				parse(*parsed[c], format, content, pStart);
+			}
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+
+	NodeId named = 0;
+	for (size_t c = 0; c < parsed.size(); c++)
+	{
+		Chunk& chunk = *parsed[c];
+		if (chunk.pBad != 0)
+		{
+			std::ostringstream message;
+			message << "cannot read the line at byte " << (chunk.pBad - pStart) << " of " << fileName;
+			m_error = message.str();
+			return false;
+		}
+		if (content == NAMED_NODES)
+		{
+			for (size_t i = 0; i < chunk.nodes.size(); i++)
+			{
+				chunk.nodes[i].id = named++;
+			}
+		}
+		m_ids = std::max(m_ids, chunk.ids);
+		m_arcs += chunk.arcs.size();
+	}
+	if (content == NAMED_NODES)
+	{
+		m_declared = m_hasDeclared ? std::min(m_declared, named) : named;
+		m_hasDeclared = true;
+	}
+
+	std::vector<std::unique_ptr<Chunk> >& kept = (content == ARCS) ? m_arcChunks : m_nodeChunks;
+	for (size_t c = 0; c < parsed.size(); c++)
+	{
+		kept.push_back(std::move(parsed[c]));
+	}
+	m_files.push_back(std::move(pFile));
+	return true;
+}
+
+// ----------------------------------------------------------------
+//  Name:           readHeader
+//  Description:    Finds the DIMACS "p" line among the comments at the
+//                  top of a file and takes the node count from it:
+//                  the first number on the line, as in "p sp 264346
+//                  733846" or "p aux sp co 264346".
+//  Arguments:      The mapped file.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void GraphImporter<NodeType, ArcType>::readHeader(char const * p, char const * pEnd)
+{
+	while (p < pEnd)
+	{
+		ImportScanner::skipBlanks(p, pEnd);
+		if (p < pEnd && *p == 'p')
+		{
+			char const * pLineEnd = p;
+			ImportScanner::skipLine(pLineEnd, pEnd);
+			for (p++; p < pLineEnd; p++)
+			{
+				unsigned long long nodes;
+				if (ImportScanner::isBlank(p[-1]) && ImportScanner::readId(p, pLineEnd, nodes))
+				{
+					m_declared = m_hasDeclared ? std::min(m_declared, (NodeId)nodes) : (NodeId)nodes;
+					m_hasDeclared = true;
+					return;
+				}
+			}
+			return;
+		}
+		if (p < pEnd && *p != 'c' && *p != '\n')
+		{
+			return;
+		}
+		ImportScanner::skipLine(p, pEnd);
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           parse
+//  Description:    Parses every line of a chunk, stopping at the
+//                  first one that cannot be read.
+//  Arguments:      The chunk, the format, what the file holds and
+//                  where the file starts (only the first chunk may
+//                  start with a CSV header).
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void GraphImporter<NodeType, ArcType>::parse(Chunk& chunk, ImportFormat format, Content content, char const * pFileStart) const
+{
+	chunk.ids = 0;
+	chunk.pBad = 0;
+	// a guess of 20 bytes a line saves most regrowth.
+	size_t guess = (chunk.pEnd - chunk.pBegin) / 20;
+	if (content == ARCS)
+	{
+		chunk.arcs.reserve(guess);
+	}
+	else
+	{
+		chunk.nodes.reserve(guess);
+	}
+
+	char const * p = chunk.pBegin;
+	char const * pEnd = chunk.pEnd;
+	if (format == IMPORT_CSV && p == pFileStart)
+	{
+		char const * pField = p;
+		ImportScanner::skipBlanks(pField, pEnd);
+		double number;
+		if (pField < pEnd && *pField != '\n' && !ImportScanner::readNumber(pField, pEnd, number))
+		{
+			ImportScanner::skipLine(p, pEnd);
+		}
+	}
+	while (p < pEnd)
+	{
+		char const * pLine = p;
+		if (!parseLine(p, pEnd, format, content, chunk))
+		{
+			chunk.pBad = pLine;
+			return;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           parseLine
+//  Description:    Parses one line into the chunk's arcs or nodes,
+//                  or passes over it if it is blank or a comment.
+//  Arguments:      The place in the chunk, which is moved to the next
+//                  line, the chunk's end, the format, what the file
+//                  holds and the chunk.
+//  Return Value:   false if the line cannot be read.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool GraphImporter<NodeType, ArcType>::parseLine(char const *& p, char const * pEnd, ImportFormat format, Content content, Chunk& chunk) const
+{
+	ImportScanner::skipBlanks(p, pEnd);
+	if (p == pEnd || *p == '\n')
+	{
+		return ImportScanner::endLine(p, pEnd);
+	}
+
+	bool csv = (format == IMPORT_CSV);
+	NodeId idBase = 0;
+	if (format == IMPORT_DIMACS)
+	{
+		if (*p == 'c' || *p == 'p')
+		{
+			ImportScanner::skipLine(p, pEnd);
+			return true;
+		}
+		if (*p != (content == ARCS ? 'a' : 'v'))
+		{
+			return false;
+		}
+		p++;
+		if (!ImportScanner::separator(p, pEnd, false))
+		{
+			return false;
+		}
+		idBase = 1;
+	}
+	else if (*p == '#' || *p == '%')
+	{
+		ImportScanner::skipLine(p, pEnd);
+		return true;
+	}
+
+	ImportedNode node;
+	unsigned long long id;
+	if (content == NAMED_NODES)
+	{
+		node.id = 0;
+		if (!ImportScanner::readWord(p, pEnd, node.pName, node.nameLength))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (!ImportScanner::readId(p, pEnd, id) || id < idBase)
+		{
+			return false;
+		}
+		node.id = (NodeId)(id - idBase);
+		node.pName = 0;
+		node.nameLength = 0;
+	}
+
+	if (content == ARCS)
+	{
+		ImportedArc arc;
+		arc.from = node.id;
+		double weight = 1;
+		if (!ImportScanner::separator(p, pEnd, csv) || !ImportScanner::readId(p, pEnd, id) || id < idBase)
+		{
+			return false;
+		}
+		arc.to = (NodeId)(id - idBase);
+		char const * pField = p;
+		if (ImportScanner::separator(p, pEnd, csv))
+		{
+			if (!ImportScanner::readNumber(p, pEnd, weight))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			p = pField;
+		}
+		if (!ImportScanner::endLine(p, pEnd))
+		{
+			return false;
+		}
+		arc.weight = (ArcType)weight;
+		chunk.arcs.push_back(arc);
+		chunk.ids = std::max(chunk.ids, std::max(arc.from, arc.to) + 1);
+		return true;
+	}
+
+	double x, y;
+	if (!ImportScanner::separator(p, pEnd, csv) || !ImportScanner::readNumber(p, pEnd, x) ||
+		!ImportScanner::separator(p, pEnd, csv) || !ImportScanner::readNumber(p, pEnd, y) ||
+		!ImportScanner::endLine(p, pEnd))
+	{
+		return false;
+	}
+	node.pos = GraphPosition((float)x, (float)y);
+	chunk.nodes.push_back(node);
+	if (content == POSITIONS)
+	{
+		chunk.ids = std::max(chunk.ids, node.id + 1);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------
+//  Name:           build
+//  Description:    Replaces the graph with what was imported. Nodes
+//                  are filled in on this thread in the order they were
+//                  imported, so when files (or lines) give the same id
+//                  the last one wins, as it would reading them one
+//                  after another. The arcs are queued in file order,
+//                  a chunk at a time, freeing each chunk as it goes so
+//                  the arcs are only held twice briefly, and
+//                  finalise() lays them out.
+//  Arguments:      The graph.
+//  Return Value:   false if nothing was imported.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool GraphImporter<NodeType, ArcType>::build(IndexedGraph<NodeType, ArcType>& graph)
+{
+	if (m_files.empty())
+	{
+		m_error = "nothing was imported";
+		return false;
+	}
+	NodeId nodes = m_hasDeclared ? m_declared : m_ids;
+	graph = IndexedGraph<NodeType, ArcType>(nodes);
+
+	size_t skipped = 0;
+	NodeType data = NodeType();
+	for (size_t c = 0; c < m_nodeChunks.size(); c++)
+	{
+		std::vector<ImportedNode> const & found = m_nodeChunks[c]->nodes;
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			if (found[i].id >= nodes)
+			{
+				skipped++;
+				continue;
+			}
+			if (found[i].pName != 0)
+			{
+				importNodeData(found[i].pName, found[i].nameLength, data);
+			}
+			graph.setNode(found[i].id, (found[i].pName != 0) ? data : graph.data(found[i].id), found[i].pos);
+		}
+		m_nodeChunks[c].reset();
+	}
+	m_nodeChunks.clear();
+
+	graph.reserveArcs(m_arcs);
+	for (size_t c = 0; c < m_arcChunks.size(); c++)
+	{
+		std::vector<ImportedArc> const & arcs = m_arcChunks[c]->arcs;
+		for (size_t i = 0; i < arcs.size(); i++)
+		{
+			if (arcs[i].from < nodes && arcs[i].to < nodes)
+			{
+				graph.addArc(arcs[i].from, arcs[i].to, arcs[i].weight);
+			}
+			else
+			{
+				skipped++;
+			}
+		}
+		m_arcChunks[c].reset();
+	}
+	m_arcChunks.clear();
+	graph.finalise();
+
+	m_skipped = skipped;
+	m_files.clear();
+	m_declared = m_ids = 0;
+	m_hasDeclared = false;
+	m_arcs = 0;
+	return true;
+}
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <list>
 
+#include "GraphPosition.h"
+
 // Forward references
 template <typename NodeType, typename ArcType> class GraphArc;
 
@@ -39,7 +41,14 @@ private:
 // -------------------------------------------------------
 	int m_costDist;
 	int m_goalcostDist;
-	sf::Vector2f position;
+	GraphPosition position;
+
+// -------------------------------------------------------
+// Description: The index of the node in the graph's node
+//              array, so searches can keep their own state
+//              in arrays instead of in the node.
+// -------------------------------------------------------
+	int m_index;
 
 public:
     // Accessor functions
@@ -74,12 +83,22 @@ public:
 		return m_costDist; 
 	}
 
-	sf::Vector2f getPos()
+	GraphPosition getPos()
 	{
 		return position;
 	}
 
-	void setPos(sf::Vector2f value)
+	int index() const
+	{
+		return m_index;
+	}
+
+	void setIndex(int value)
+	{
+		m_index = value;
+	}
+
+	void setPos(GraphPosition value)
 	{
 		position = value;
 	}
@@ -110,8 +129,8 @@ public:
 template<typename NodeType, typename ArcType>
 GraphArc<NodeType, ArcType>* GraphNode<NodeType, ArcType>::getArc( Node* pNode ) {
 
-     list<Arc>::iterator iter = m_arcList.begin();
-     list<Arc>::iterator endIter = m_arcList.end();
+     typename list<Arc>::iterator iter = m_arcList.begin();
+     typename list<Arc>::iterator endIter = m_arcList.end();
      Arc* pArc = 0;
 
      // find the arc that matches the node
@@ -156,15 +175,14 @@ void GraphNode<NodeType, ArcType>::addArc( Node* pNode, ArcType weight ) {
 // ----------------------------------------------------------------
 template<typename NodeType, typename ArcType>
 void GraphNode<NodeType, ArcType>::removeArc( Node* pNode ) {
-	list<Arc>::iterator iter = m_arcList.begin();
-	list<Arc>::iterator endIter = m_arcList.end();
-
-	int size = m_arcList.size();
+	typename list<Arc>::iterator iter = m_arcList.begin();
+	typename list<Arc>::iterator endIter = m_arcList.end();
 
 	// find the arc that matches the node
-	for (; iter != endIter && m_arcList.size() == size; ++iter) {
+	for (; iter != endIter; ++iter) {
 		if ((*iter).node() == pNode) {
-			m_arcList.remove((*iter));
+			m_arcList.erase(iter);
+			break;
 		}
 	}
 
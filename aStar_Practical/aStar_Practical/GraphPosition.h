@@ -0,0 +1,42 @@
+#ifndef GRAPHPOSITION_H
+#define GRAPHPOSITION_H
+
+// ----------------------------------------------------------------
+//  Name:           GraphPosition
+//  Description:    The coordinate type nodes are placed with. The
+//                  graph and search headers only need a type laid out
+//                  as two public floats, x then y (the vector kernels
+//                  and the partition files read positions as raw
+//                  floats), with a constructor taking both, so the
+//                  type is chosen at compile time:
+//                  GRAPH_USE_SFML      sf::Vector2f, for the
+//                                      visualiser, which draws
+//                                      straight from node positions.
+//                  GRAPH_POSITION_TYPE any other type, whose header
+//                                      must be included first.
+//                  neither             the plain struct below, so
+//                                      servers and tools can use the
+//                                      graph without SFML at all.
+// ----------------------------------------------------------------
+#if defined(GRAPH_USE_SFML)
+
+#include "SFML/System/Vector2.hpp"
+typedef sf::Vector2f GraphPosition;
+
+#elif defined(GRAPH_POSITION_TYPE)
+
+typedef GRAPH_POSITION_TYPE GraphPosition;
+
+#else
+
+struct GraphPosition {
+	float x;
+	float y;
+
+	GraphPosition() : x(0), y(0) {}
+	GraphPosition(float x, float y) : x(x), y(y) {}
+};
+
+#endif
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef GRAPHSNAPSHOT_H
+#define GRAPHSNAPSHOT_H
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Graph.h"
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           GraphSnapshot
+//  Description:    One immutable version of a graph. The nodes are
+//                  split into fixed size blocks, each holding the
+//                  data, position and outgoing arcs of its nodes.
+//                  Blocks are shared between versions, so a new
+//                  version only copies the blocks its edits touched
+//                  and points at the rest of the previous version's.
+//                  Nothing in a published snapshot ever changes, so
+//                  any number of threads can search one at once
+//                  without locks.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class GraphSnapshot {
+public:
+	typedef std::pair<NodeId, ArcType> OutArc;
+
+	struct Entry {
+		bool present;
+		NodeType data;
+		GraphPosition pos;
+		std::vector<OutArc> arcs;
+
+		Entry() : present(false) {}
+	};
+	typedef std::vector<Entry> Block;
+
+	// Nodes per block: small enough that copying a block for one edit
+	// is cheap, large enough that the block table stays short.
+	static NodeId blockSize()
+	{
+		return 64;
+	}
+
+private:
+	// Follows a node's stored arcs, for BestFirstSearch.
+	struct SnapshotArcs {
+		GraphSnapshot const & snapshot;
+
+		template<class Relax>
+		bool operator()(NodeId node, Relax& relax) const
+		{
+			std::vector<OutArc> const & arcs = snapshot.node(node).arcs;
+			for (size_t i = 0; i < arcs.size(); i++)
+			{
+				relax(arcs[i].first, arcs[i].second);
+			}
+			return true;
+		}
+	};
+
+	NodeId m_nodes;
+	unsigned long long m_version;
+	float m_scale;
+	std::vector<std::shared_ptr<Block const> > m_blocks;
+
+	template<class N, class A> friend class VersionedGraph;
+
+public:
+	GraphSnapshot(NodeId nodes, unsigned long long version) : m_nodes(nodes), m_version(version), m_scale(0) {}
+
+	NodeId nodeCount() const
+	{
+		return m_nodes;
+	}
+
+	// Increases by one with every published edit.
+	unsigned long long version() const
+	{
+		return m_version;
+	}
+
+	// The graph's heuristicScale() when this version was published.
+	float heuristicScale() const
+	{
+		return m_scale;
+	}
+
+	Entry const & node(NodeId node) const
+	{
+		return (*m_blocks[node / blockSize()])[node % blockSize()];
+	}
+
+	bool aStar(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const;
+};
+
+// ----------------------------------------------------------------
+//  Name:           aStar
+//  Description:    A* over this version of the graph, with the same
+//                  scaled straight line estimate as Graph::aStar.
+//  Arguments:      The start and goal, the search space to work in
+//                  and the vector the path is written to, goal first.
+//  Return Value:   true if the goal can be reached.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool GraphSnapshot<NodeType, ArcType>::aStar(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+{
+	GraphPosition goal = node(dest).pos;
+	space.reset(m_nodes);
+	BestFirstSearch<ArcType, IndexedSearchSpace<ArcType> > bestFirst(space);
+	bestFirst.start(start, 0, 0);
+	SnapshotArcs arcs = { *this };
+	NodeId found = bestFirst.run(arcs, [&](NodeId child)
+	{
+		float x = goal.x - node(child).pos.x;
+		float y = goal.y - node(child).pos.y;
+		return (ArcType)(m_scale * sqrt(x * x + y * y));
+	}, [&](NodeId n) { return n == dest; });
+	if (found == invalidNodeId())
+	{
+		return false;
+	}
+	space.path(found, path);
+	return true;
+}
+
+// ----------------------------------------------------------------
+//  Name:           VersionedGraph
+//  Description:    Publishes snapshots of a Graph, read-copy-update
+//                  style. It listens to the graph and applies each
+//                  edit to a private next version, copying a block
+//                  the first time an edit touches it. publish() then
+//                  swaps the next version in with one atomic store.
+//                  Readers take the current version with acquire()
+//                  and keep it for as long as their query runs, so a
+//                  query that started before an edit finishes on the
+//                  version it started with. A version is freed when
+//                  the last reader holding it lets go.
+//                  The Graph itself is still only safe to touch from
+//                  the thread that edits it; other threads should
+//                  search snapshots instead.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class VersionedGraph : public Graph<NodeType, ArcType>::Listener {
+private:
+	typedef GraphArc<NodeType, ArcType> Arc;
+	typedef GraphNode<NodeType, ArcType> Node;
+	typedef GraphSnapshot<NodeType, ArcType> Snapshot;
+	typedef typename Snapshot::Block Block;
+	typedef typename Snapshot::Entry Entry;
+
+	Graph<NodeType, ArcType>& m_graph;
+
+	// Only read and written through std::atomic_load/atomic_store.
+	std::shared_ptr<Snapshot const> m_current;
+
+// ----------------------------------------------------------------
+//  Description:    The version being built from the edits since the
+//                  last publish, and which of its blocks are already
+//                  private copies that may be changed in place. Only
+//                  touched with m_writeMutex held, once the graph is
+//                  being listened to.
+// ----------------------------------------------------------------
+	std::shared_ptr<Snapshot> m_next;
+	std::vector<char> m_copied;
+	bool m_edited;
+	mutable std::mutex m_writeMutex;
+
+	VersionedGraph(VersionedGraph const &);
+	VersionedGraph& operator=(VersionedGraph const &);
+
+	void startNext();
+	Entry& writable(NodeId node);
+	void copyNode(int index);
+
+public:
+	VersionedGraph(Graph<NodeType, ArcType>& graph);
+	~VersionedGraph();
+
+	// The latest published version. Safe to call from any thread.
+	std::shared_ptr<Snapshot const> acquire() const
+	{
+		return std::atomic_load(&m_current);
+	}
+
+	// true if there are edits that have not been published.
+	bool pending() const
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		return m_edited;
+	}
+
+	void publish();
+
+	// Graph::Listener
+	void nodeAdded(int index);
+	void nodeRemoved(int index);
+	void arcAdded(int from, int to, ArcType weight);
+	void arcRemoved(int from, int to);
+};
+
+template<class NodeType, class ArcType>
+VersionedGraph<NodeType, ArcType>::VersionedGraph(Graph<NodeType, ArcType>& graph) : m_graph(graph), m_edited(false)
+{
+	// the first version is built in full, one private block at a time.
+	NodeId nodes = (NodeId)m_graph.maxNodes();
+	std::shared_ptr<Snapshot> first(new Snapshot(nodes, 0));
+	for (NodeId begin = 0; begin < nodes; begin += Snapshot::blockSize())
+	{
+		first->m_blocks.push_back(std::shared_ptr<Block const>(new Block(Snapshot::blockSize())));
+	}
+	m_next = first;
+	m_copied.assign(first->m_blocks.size(), true);
+	for (int i = 0; i < m_graph.maxNodes(); i++)
+	{
+		if (m_graph.nodeArray()[i] != 0)
+		{
+			copyNode(i);
+		}
+	}
+	first->m_scale = m_graph.heuristicScale();
+	std::atomic_store(&m_current, std::shared_ptr<Snapshot const>(first));
+	startNext();
+	m_graph.addListener(this);
+}
+
+template<class NodeType, class ArcType>
+VersionedGraph<NodeType, ArcType>::~VersionedGraph()
+{
+	m_graph.removeListener(this);
+}
+
+// ----------------------------------------------------------------
+//  Name:           startNext
+//  Description:    Begins the next version as a copy of the current
+//                  one's block table, sharing every block.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::startNext()
+{
+	std::shared_ptr<Snapshot const> current = std::atomic_load(&m_current);
+	m_next.reset(new Snapshot(current->m_nodes, current->m_version + 1));
+	m_next->m_blocks = current->m_blocks;
+	m_copied.assign(m_next->m_blocks.size(), false);
+	m_edited = false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           writable
+//  Description:    The next version's entry for a node, copying its
+//                  block first if the block is still shared.
+//  Arguments:      The node.
+//  Return Value:   The entry, which may be changed.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+typename VersionedGraph<NodeType, ArcType>::Entry& VersionedGraph<NodeType, ArcType>::writable(NodeId node)
+{
+	NodeId block = node / Snapshot::blockSize();
+	if (!m_copied[block])
+	{
+		m_next->m_blocks[block] = std::shared_ptr<Block const>(new Block(*m_next->m_blocks[block]));
+		m_copied[block] = true;
+	}
+	m_edited = true;
+	// the block is private to the unpublished version, so this is safe.
+	Block& writableBlock = const_cast<Block&>(*m_next->m_blocks[block]);
+	return writableBlock[node % Snapshot::blockSize()];
+}
+
+// ----------------------------------------------------------------
+//  Name:           copyNode
+//  Description:    Copies a node and its arcs from the graph into the
+//                  next version.
+//  Arguments:      The node's index.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::copyNode(int index)
+{
+	Node* pNode = m_graph.nodeArray()[index];
+	Entry& entry = writable(index);
+	entry.present = true;
+	entry.data = pNode->data();
+	entry.pos = pNode->getPos();
+	entry.arcs.clear();
+	typename list<Arc>::const_iterator iter = pNode->arcList().begin();
+	for (; iter != pNode->arcList().end(); ++iter)
+	{
+		entry.arcs.push_back(typename Snapshot::OutArc((*iter).node()->index(), (*iter).weight()));
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           publish
+//  Description:    Makes the edits so far visible to new readers,
+//                  with the graph's heuristic scale as it is now, so
+//                  it must be called from the thread that edits the
+//                  graph. Readers that already hold a version keep it.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::publish()
+{
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	if (!m_edited)
+	{
+		return;
+	}
+	m_next->m_scale = m_graph.heuristicScale();
+	std::shared_ptr<Snapshot const> next = m_next;
+	std::atomic_store(&m_current, next);
+	startNext();
+}
+
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::nodeAdded(int index)
+{
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	copyNode(index);
+}
+
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::nodeRemoved(int index)
+{
+	// the arcs into the node have already gone through arcRemoved.
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	Entry& entry = writable(index);
+	entry.present = false;
+	entry.arcs.clear();
+}
+
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::arcAdded(int from, int to, ArcType weight)
+{
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	writable(from).arcs.push_back(typename Snapshot::OutArc(to, weight));
+}
+
+template<class NodeType, class ArcType>
+void VersionedGraph<NodeType, ArcType>::arcRemoved(int from, int to)
+{
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	std::vector<typename Snapshot::OutArc>& arcs = writable(from).arcs;
+	for (size_t i = 0; i < arcs.size(); i++)
+	{
+		if (arcs[i].first == (NodeId)to)
+		{
+			arcs.erase(arcs.begin() + i);
+			break;
+		}
+	}
+}
+
+#endif
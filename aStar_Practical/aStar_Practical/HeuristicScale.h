@@ -0,0 +1,81 @@
+#ifndef HEURISTICSCALE_H
+#define HEURISTICSCALE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "GraphPosition.h"
+
+// ----------------------------------------------------------------
+//  Name:           HeuristicCalibration
+//  Description:    Works out how to turn straight line distance
+//                  between node positions into an A* estimate when
+//                  arc weights are in some other unit. Fed every arc,
+//                  it keeps the lowest weight per unit of length;
+//                  scaling distance by that is the largest estimate
+//                  that never claims an arc is dearer than it is, so
+//                  it is consistent (and so admissible) for any goal:
+//                  by the triangle inequality
+//                      scale * d(u, goal) <= scale * d(u, v) + scale * d(v, goal)
+//                                         <= weight(u, v) + scale * d(v, goal).
+//                  Arcs of no length say nothing and are skipped. A
+//                  graph with no arcs of any length gets scale 0, so
+//                  A* falls back to uniform cost search.
+// ----------------------------------------------------------------
+class HeuristicCalibration {
+private:
+	double m_scale;
+
+public:
+	HeuristicCalibration() : m_scale(std::numeric_limits<double>::max()) {}
+
+	static float length(GraphPosition from, GraphPosition to)
+	{
+		float x = to.x - from.x;
+		float y = to.y - from.y;
+		return std::sqrt(x * x + y * y);
+	}
+
+	void addArc(GraphPosition from, GraphPosition to, double weight)
+	{
+		float arcLength = length(from, to);
+		if (arcLength > 0)
+		{
+			m_scale = std::min(m_scale, weight / arcLength);
+		}
+	}
+
+	// The scale, shaved a little so that float rounding in the
+	// estimate cannot push it over an arc's weight.
+	float scale() const
+	{
+		if (m_scale == std::numeric_limits<double>::max())
+		{
+			return 0;
+		}
+		return (float)(std::max(m_scale, 0.0) * (1 - 1e-5));
+	}
+
+	// Whether an arc breaks consistency at the given scale.
+	static bool violates(GraphPosition from, GraphPosition to, double weight, float scale)
+	{
+		return scale * length(from, to) > weight;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           HeuristicViolation
+//  Description:    An arc along which the scaled estimate drops by
+//                  more than the arc's weight, as reported by the
+//                  graphs' validateHeuristic().
+// ----------------------------------------------------------------
+template<class ArcType>
+struct HeuristicViolation {
+	int from;
+	int to;
+	ArcType weight;
+	float estimate;
+};
+
+#endif
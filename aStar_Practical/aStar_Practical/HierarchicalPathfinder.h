@@ -0,0 +1,544 @@
+#ifndef HIERARCHICALPATHFINDER_H
+#define HIERARCHICALPATHFINDER_H
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "Graph.h"
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           HierarchicalPathfinder
+//  Description:    HPA* over a Graph. The map is cut into square
+//                  clusters by node position. A node with an arc
+//                  leaving or entering its cluster is an entrance.
+//                  The abstract graph joins the entrances with the
+//                  arcs between clusters plus, inside each cluster,
+//                  the cost of the best path between each pair of
+//                  entrances, found with a uniform cost search that
+//                  never leaves the cluster.
+//                  A query searches the abstract graph and then only
+//                  refines the segments on the chosen route. The
+//                  finder listens to the graph, and an edit marks the
+//                  clusters it touches so that only they are rebuilt
+//                  before the next query.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class HierarchicalPathfinder : public Graph<NodeType, ArcType>::Listener {
+private:
+	typedef GraphArc<NodeType, ArcType> Arc;
+	typedef GraphNode<NodeType, ArcType> Node;
+
+	struct AbstractEdge {
+		int to;
+		ArcType cost;
+	};
+
+	struct OpenEntry {
+		ArcType f;
+		ArcType costDist;
+		int node;
+
+		bool operator>(OpenEntry const & other) const
+		{
+			return f > other.f;
+		}
+	};
+
+	Graph<NodeType, ArcType>& m_graph;
+	float m_clusterSize;
+	float m_scale;
+
+// ----------------------------------------------------------------
+//  Description:    The cluster each node index is in (-1 for empty
+//                  slots), the nodes of each cluster and the map
+//                  from cluster grid cell to cluster.
+// ----------------------------------------------------------------
+	std::vector<int> m_clusterOf;
+	std::vector<std::vector<int> > m_clusterNodes;
+	std::map<std::pair<int, int>, int> m_clusterCells;
+
+// ----------------------------------------------------------------
+//  Description:    Arcs from other clusters into each node. Kept up
+//                  to date on every edit so a cluster can find its
+//                  entrances without looking at any other cluster.
+// ----------------------------------------------------------------
+	std::vector<int> m_crossIn;
+
+// ----------------------------------------------------------------
+//  Description:    The abstract graph, indexed by node index. Only
+//                  entrances have edges.
+// ----------------------------------------------------------------
+	std::vector<std::vector<AbstractEdge> > m_abstract;
+	std::vector<std::vector<int> > m_entrances;
+	std::vector<char> m_dirty;
+
+	IndexedSearchSpace<ArcType> m_localSpace;
+	IndexedSearchSpace<ArcType> m_abstractSpace;
+
+	HierarchicalPathfinder(HierarchicalPathfinder const &);
+	HierarchicalPathfinder& operator=(HierarchicalPathfinder const &);
+
+	Node* node(int index) const
+	{
+		return m_graph.nodeArray()[index];
+	}
+
+	ArcType estimate(int from, int to) const
+	{
+		float x = node(to)->getPos().x - node(from)->getPos().x;
+		float y = node(to)->getPos().y - node(from)->getPos().y;
+		return (ArcType)(m_scale * sqrt(x * x + y * y));
+	}
+
+	bool crosses(int from, int to) const
+	{
+		return m_clusterOf[from] != m_clusterOf[to];
+	}
+
+	void grow(int nodes)
+	{
+		if ((int)m_clusterOf.size() < nodes)
+		{
+			m_clusterOf.resize(nodes, -1);
+			m_crossIn.resize(nodes, 0);
+			m_abstract.resize(nodes);
+		}
+	}
+
+	void markDirty(int cluster)
+	{
+		if (cluster >= 0)
+		{
+			m_dirty[cluster] = true;
+		}
+	}
+
+	void assignCluster(int index);
+	void unassignCluster(int index);
+	void rebuildCluster(int cluster);
+	void localSearch(int from, int cluster);
+	void refine(int from, int to, std::vector<Node*>& path);
+
+public:
+	HierarchicalPathfinder(Graph<NodeType, ArcType>& graph, float clusterSize);
+	~HierarchicalPathfinder();
+
+	int clusterCount() const
+	{
+		return (int)m_clusterNodes.size();
+	}
+
+	int cluster(int index) const
+	{
+		return m_clusterOf[index];
+	}
+
+	std::vector<int> const & entrances(int cluster) const
+	{
+		return m_entrances[cluster];
+	}
+
+	void refresh();
+	bool findPath(Node* pStart, Node* pDest, std::vector<Node*>& path);
+
+	// Graph::Listener
+	void nodeAdded(int index);
+	void nodeRemoved(int index);
+	void arcAdded(int from, int to, ArcType weight);
+	void arcRemoved(int from, int to);
+};
+
+// ----------------------------------------------------------------
+//  Name:           HierarchicalPathfinder
+//  Description:    Splits the graph into clusters and builds the
+//                  abstract graph, then starts listening for edits.
+//  Arguments:      The graph and the width of a cluster in the same
+//                  units as the node positions.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+HierarchicalPathfinder<NodeType, ArcType>::HierarchicalPathfinder(Graph<NodeType, ArcType>& graph, float clusterSize)
+	: m_graph(graph), m_clusterSize(clusterSize), m_scale(0)
+{
+	grow(graph.maxNodes());
+	for (int i = 0; i < graph.maxNodes(); i++)
+	{
+		if (node(i) != 0)
+		{
+			assignCluster(i);
+		}
+	}
+	for (int i = 0; i < graph.maxNodes(); i++)
+	{
+		if (node(i) != 0)
+		{
+			typename list<Arc>::const_iterator iter = node(i)->arcList().begin();
+			for (; iter != node(i)->arcList().end(); ++iter)
+			{
+				if (crosses(i, (*iter).node()->index()))
+				{
+					m_crossIn[(*iter).node()->index()]++;
+				}
+			}
+		}
+	}
+	refresh();
+	m_graph.addListener(this);
+}
+
+template<class NodeType, class ArcType>
+HierarchicalPathfinder<NodeType, ArcType>::~HierarchicalPathfinder()
+{
+	m_graph.removeListener(this);
+}
+
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::assignCluster(int index)
+{
+	std::pair<int, int> cell((int)floor(node(index)->getPos().x / m_clusterSize),
+		(int)floor(node(index)->getPos().y / m_clusterSize));
+	typename std::map<std::pair<int, int>, int>::iterator iter = m_clusterCells.find(cell);
+	int cluster;
+	if (iter == m_clusterCells.end())
+	{
+		cluster = (int)m_clusterNodes.size();
+		m_clusterCells[cell] = cluster;
+		m_clusterNodes.push_back(std::vector<int>());
+		m_entrances.push_back(std::vector<int>());
+		m_dirty.push_back(true);
+	}
+	else
+	{
+		cluster = iter->second;
+	}
+	m_clusterOf[index] = cluster;
+	m_clusterNodes[cluster].push_back(index);
+	markDirty(cluster);
+}
+
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::unassignCluster(int index)
+{
+	int cluster = m_clusterOf[index];
+	std::vector<int>& nodes = m_clusterNodes[cluster];
+	nodes.erase(std::remove(nodes.begin(), nodes.end(), index), nodes.end());
+	m_clusterOf[index] = -1;
+	m_abstract[index].clear();
+	markDirty(cluster);
+}
+
+// ----------------------------------------------------------------
+//  Name:           localSearch
+//  Description:    Uniform cost search from a node that only visits
+//                  nodes in the given cluster. The costs are left in
+//                  m_localSpace.
+//  Arguments:      The start node index and the cluster.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::localSearch(int from, int cluster)
+{
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > open;
+	m_localSpace.reset((NodeId)m_clusterOf.size());
+	m_localSpace.set(from, 0, invalidNodeId());
+	OpenEntry first = { 0, 0, from };
+	open.push(first);
+
+	while (!open.empty())
+	{
+		OpenEntry top = open.top();
+		open.pop();
+		if (top.costDist != m_localSpace.costDist(top.node))
+		{
+			continue;
+		}
+
+		typename list<Arc>::const_iterator iter = node(top.node)->arcList().begin();
+		for (; iter != node(top.node)->arcList().end(); ++iter)
+		{
+			int child = (*iter).node()->index();
+			ArcType dist = top.costDist + (*iter).weight();
+			if (m_clusterOf[child] == cluster && dist < m_localSpace.costDist(child))
+			{
+				m_localSpace.set(child, dist, top.node);
+				OpenEntry entry = { dist, dist, child };
+				open.push(entry);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           rebuildCluster
+//  Description:    Works out the cluster's entrances again and
+//                  rebuilds their abstract edges.
+//  Arguments:      The cluster.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::rebuildCluster(int cluster)
+{
+	std::vector<int> const & nodes = m_clusterNodes[cluster];
+	std::vector<int>& entrances = m_entrances[cluster];
+	entrances.clear();
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		int index = nodes[i];
+		m_abstract[index].clear();
+		bool entrance = m_crossIn[index] > 0;
+
+		// arcs leaving the cluster are abstract edges as they are.
+		typename list<Arc>::const_iterator iter = node(index)->arcList().begin();
+		for (; iter != node(index)->arcList().end(); ++iter)
+		{
+			int to = (*iter).node()->index();
+			if (crosses(index, to))
+			{
+				AbstractEdge edge = { to, (*iter).weight() };
+				m_abstract[index].push_back(edge);
+				entrance = true;
+			}
+		}
+		if (entrance)
+		{
+			entrances.push_back(index);
+		}
+	}
+
+	for (size_t i = 0; i < entrances.size(); i++)
+	{
+		localSearch(entrances[i], cluster);
+		for (size_t j = 0; j < entrances.size(); j++)
+		{
+			if (i != j && m_localSpace.reached(entrances[j]))
+			{
+				AbstractEdge edge = { entrances[j], m_localSpace.costDist(entrances[j]) };
+				m_abstract[entrances[i]].push_back(edge);
+			}
+		}
+	}
+	m_dirty[cluster] = false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           refresh
+//  Description:    Rebuilds every cluster an edit has touched since
+//                  the last refresh, and takes the graph's heuristic
+//                  scale again, as an edit may have lowered it. Every
+//                  abstract edge costs at least its scaled length, so
+//                  the estimate stays consistent on the abstract graph.
+//                  findPath calls this itself.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::refresh()
+{
+	m_scale = m_graph.heuristicScale();
+	for (size_t cluster = 0; cluster < m_dirty.size(); cluster++)
+	{
+		if (m_dirty[cluster])
+		{
+			rebuildCluster((int)cluster);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           refine
+//  Description:    Appends the nodes of one abstract segment to the
+//                  path, not including the first node of the
+//                  segment. Segments between clusters are single
+//                  arcs; segments inside a cluster are searched for
+//                  again within the cluster.
+//  Arguments:      The node indices at each end of the segment and
+//                  the path, which is built start first.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::refine(int from, int to, std::vector<Node*>& path)
+{
+	if (crosses(from, to))
+	{
+		path.push_back(node(to));
+		return;
+	}
+
+	localSearch(from, m_clusterOf[from]);
+	std::vector<NodeId> segment;
+	m_localSpace.path(to, segment);
+	// segment is goal first and includes "from", which is already on the path.
+	for (int i = (int)segment.size() - 2; i >= 0; i--)
+	{
+		path.push_back(node(segment[i]));
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           findPath
+//  Description:    Finds a path through the abstract graph with the
+//                  start and destination joined to the entrances of
+//                  their clusters, then refines it.
+//  Arguments:      The start and destination nodes, and the vector
+//                  the path is written to (goal first, like aStar).
+//  Return Value:   true if a path was found.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool HierarchicalPathfinder<NodeType, ArcType>::findPath(Node* pStart, Node* pDest, std::vector<Node*>& path)
+{
+	refresh();
+	int start = pStart->index();
+	int dest = pDest->index();
+	int startCluster = m_clusterOf[start];
+	int destCluster = m_clusterOf[dest];
+
+	// join the start to its cluster's entrances, and to the goal if
+	// they share a cluster.
+	std::vector<AbstractEdge> startEdges;
+	localSearch(start, startCluster);
+	std::vector<int> const & startEntrances = m_entrances[startCluster];
+	for (size_t i = 0; i < startEntrances.size(); i++)
+	{
+		if (m_localSpace.reached(startEntrances[i]))
+		{
+			AbstractEdge edge = { startEntrances[i], m_localSpace.costDist(startEntrances[i]) };
+			startEdges.push_back(edge);
+		}
+	}
+	if (startCluster == destCluster && m_localSpace.reached(dest))
+	{
+		AbstractEdge edge = { dest, m_localSpace.costDist(dest) };
+		startEdges.push_back(edge);
+	}
+
+	// join the goal cluster's entrances to the goal.
+	std::map<int, ArcType> destEdges;
+	std::vector<int> const & destEntrances = m_entrances[destCluster];
+	for (size_t i = 0; i < destEntrances.size(); i++)
+	{
+		localSearch(destEntrances[i], destCluster);
+		if (m_localSpace.reached(dest))
+		{
+			destEdges[destEntrances[i]] = m_localSpace.costDist(dest);
+		}
+	}
+
+	// A* over the abstract graph.
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > open;
+	m_abstractSpace.reset((NodeId)m_clusterOf.size());
+	m_abstractSpace.set(start, 0, invalidNodeId());
+	OpenEntry first = { estimate(start, dest), 0, start };
+	open.push(first);
+	bool found = false;
+
+	while (!open.empty() && !found)
+	{
+		OpenEntry top = open.top();
+		open.pop();
+		if (top.costDist != m_abstractSpace.costDist(top.node))
+		{
+			continue;
+		}
+		if (top.node == dest)
+		{
+			found = true;
+			break;
+		}
+
+		std::vector<AbstractEdge> const & edges = (top.node == start) ? startEdges : m_abstract[top.node];
+		std::vector<AbstractEdge> extra;
+		if (top.node == start && m_clusterOf[start] >= 0)
+		{
+			extra = m_abstract[start];
+		}
+		typename std::map<int, ArcType>::const_iterator toDest = destEdges.find(top.node);
+		if (toDest != destEdges.end())
+		{
+			AbstractEdge edge = { dest, toDest->second };
+			extra.push_back(edge);
+		}
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			std::vector<AbstractEdge> const & adjacent = (pass == 0) ? edges : extra;
+			for (size_t i = 0; i < adjacent.size(); i++)
+			{
+				ArcType dist = top.costDist + adjacent[i].cost;
+				if (dist < m_abstractSpace.costDist(adjacent[i].to))
+				{
+					m_abstractSpace.set(adjacent[i].to, dist, top.node);
+					OpenEntry entry = { dist + estimate(adjacent[i].to, dest), dist, adjacent[i].to };
+					open.push(entry);
+				}
+			}
+		}
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	std::vector<NodeId> abstractPath;
+	m_abstractSpace.path(dest, abstractPath);
+
+	std::vector<Node*> refined;
+	refined.push_back(pStart);
+	for (int i = (int)abstractPath.size() - 1; i > 0; i--)
+	{
+		refine(abstractPath[i], abstractPath[i - 1], refined);
+	}
+	path.insert(path.end(), refined.rbegin(), refined.rend());
+	return true;
+}
+
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::nodeAdded(int index)
+{
+	grow(m_graph.maxNodes());
+	assignCluster(index);
+}
+
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::nodeRemoved(int index)
+{
+	// arcs into the node have already been removed one by one; its own
+	// arcs go with it.
+	typename list<Arc>::const_iterator iter = node(index)->arcList().begin();
+	for (; iter != node(index)->arcList().end(); ++iter)
+	{
+		arcRemoved(index, (*iter).node()->index());
+	}
+	unassignCluster(index);
+}
+
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::arcAdded(int from, int to, ArcType weight)
+{
+	if (crosses(from, to))
+	{
+		m_crossIn[to]++;
+		markDirty(m_clusterOf[to]);
+	}
+	markDirty(m_clusterOf[from]);
+}
+
+template<class NodeType, class ArcType>
+void HierarchicalPathfinder<NodeType, ArcType>::arcRemoved(int from, int to)
+{
+	if (crosses(from, to))
+	{
+		m_crossIn[to]--;
+		markDirty(m_clusterOf[to]);
+	}
+	markDirty(m_clusterOf[from]);
+}
+
+#endif
@@ -0,0 +1,805 @@
+#ifndef INDEXEDGRAPH_H
+#define INDEXEDGRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "ArcRelaxation.h"
+#include "Graph.h"
+#include "HeuristicScale.h"
+
+// ----------------------------------------------------------------
+//  Name:           NodeId
+//  Description:    A node in an IndexedGraph is named by a 32 bit
+//                  index rather than a pointer.
+// ----------------------------------------------------------------
+typedef unsigned int NodeId;
+
+inline NodeId invalidNodeId()
+{
+	return 0xFFFFFFFFu;
+}
+
+// ----------------------------------------------------------------
+//  Name:           SearchSource
+//  Description:    One of several places a search may start from,
+//                  with the cost already spent getting there (0 for
+//                  a plain start).
+// ----------------------------------------------------------------
+template<class ArcType>
+struct SearchSource {
+	NodeId node;
+	ArcType offset;
+};
+
+// ----------------------------------------------------------------
+//  Name:           IndexedSearchSpace
+//  Description:    The hot per node state of a search, kept apart
+//                  from the graph as dense arrays. A node's entries
+//                  only count if its stamp matches the current
+//                  generation, so starting a new search is O(1)
+//                  instead of a pass over every node. One search
+//                  space serves one search at a time; give each
+//                  thread its own to search the same graph at once.
+// ----------------------------------------------------------------
+template<class ArcType>
+class IndexedSearchSpace {
+private:
+	std::vector<ArcType> m_costDist;
+	std::vector<NodeId> m_prev;
+	std::vector<unsigned int> m_stamp;
+	unsigned int m_generation;
+
+public:
+	IndexedSearchSpace() : m_generation(0) {}
+
+	// Clears every node for a new search over a graph of the given size.
+	void reset(NodeId nodes)
+	{
+		if (m_stamp.size() != nodes)
+		{
+			m_costDist.assign(nodes, ArcType());
+			m_prev.assign(nodes, invalidNodeId());
+			m_stamp.assign(nodes, 0);
+			m_generation = 0;
+		}
+		m_generation++;
+		if (m_generation == 0)
+		{
+			// the stamps wrapped, so they have to be cleared for real.
+			m_stamp.assign(nodes, 0);
+			m_generation = 1;
+		}
+	}
+
+	bool reached(NodeId node) const
+	{
+		return m_stamp[node] == m_generation;
+	}
+
+	ArcType costDist(NodeId node) const
+	{
+		return reached(node) ? m_costDist[node] : numeric_limits<ArcType>::max();
+	}
+
+	NodeId prev(NodeId node) const
+	{
+		return reached(node) ? m_prev[node] : invalidNodeId();
+	}
+
+	// The raw arrays, for the vector relaxation kernel (ArcRelaxation.h).
+	ArcType const * costArray() const
+	{
+		return &m_costDist[0];
+	}
+
+	unsigned int const * stampArray() const
+	{
+		return &m_stamp[0];
+	}
+
+	unsigned int generation() const
+	{
+		return m_generation;
+	}
+
+	void set(NodeId node, ArcType cost, NodeId prev)
+	{
+		m_costDist[node] = cost;
+		m_prev[node] = prev;
+		m_stamp[node] = m_generation;
+	}
+
+	// Writes the path to the node in the same order as Graph::aStar,
+	// goal first. Nothing is written if the node was not reached.
+	void path(NodeId node, std::vector<NodeId>& path) const
+	{
+		if (reached(node))
+		{
+			for (; node != invalidNodeId(); node = prev(node))
+			{
+				path.push_back(node);
+			}
+		}
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           BestFirstSearch
+//  Description:    The open list loop the A* searches over indexed
+//                  nodes share. The open list holds a node again each
+//                  time its cost improves and stale entries are
+//                  skipped, so no decrease-key is needed. The
+//                  searches only differ in what they keep their costs
+//                  in, which arcs they follow, their estimate and
+//                  where they stop, so those are passed in:
+//                  - the space has costDist(node) and
+//                    set(node, cost, prev), like IndexedSearchSpace;
+//                  - visitArcs(node, relax) calls relax(target,
+//                    weight) for each arc of the node the search may
+//                    follow, and returns false to give the search up;
+//                  - estimate(node) is the estimate to the goal;
+//                  - isGoal(node) is true for the node to stop at.
+// ----------------------------------------------------------------
+template<class ArcType, class Space>
+class BestFirstSearch {
+private:
+	// costDist is the cost the node had when it was pushed, which
+	// tells stale entries apart.
+	struct OpenEntry {
+		ArcType f;
+		ArcType costDist;
+		NodeId node;
+
+		bool operator>(OpenEntry const & other) const
+		{
+			return f > other.f;
+		}
+	};
+
+	Space& m_space;
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > m_open;
+
+	BestFirstSearch(BestFirstSearch const &);
+	BestFirstSearch& operator=(BestFirstSearch const &);
+
+public:
+	// What visitArcs is handed for the node being expanded.
+	template<class Estimate>
+	class Relax {
+	private:
+		BestFirstSearch& m_search;
+		Estimate m_estimate;
+		NodeId m_node;
+		ArcType m_costDist;
+
+		Relax& operator=(Relax const &);
+
+	public:
+		Relax(BestFirstSearch& search, Estimate const & estimate, NodeId node, ArcType costDist)
+			: m_search(search), m_estimate(estimate), m_node(node), m_costDist(costDist)
+		{
+		}
+
+		void operator()(NodeId child, ArcType weight)
+		{
+			ArcType dist = m_costDist + weight;
+			if (dist < m_search.m_space.costDist(child))
+			{
+				m_search.m_space.set(child, dist, m_node);
+				OpenEntry entry = { dist + m_estimate(child), dist, child };
+				m_search.m_open.push(entry);
+			}
+		}
+	};
+
+	// The space must already be reset for this search.
+	BestFirstSearch(Space& space) : m_space(space) {}
+
+	// Starts the search from a node, costDist having been spent
+	// getting there, unless another start already reaches it for
+	// less. f is costDist plus the node's estimate.
+	void start(NodeId node, ArcType costDist, ArcType f)
+	{
+		if (costDist < m_space.costDist(node))
+		{
+			m_space.set(node, costDist, invalidNodeId());
+			OpenEntry entry = { f, costDist, node };
+			m_open.push(entry);
+		}
+	}
+
+	template<class VisitArcs, class Estimate, class IsGoal>
+	NodeId run(VisitArcs visitArcs, Estimate estimate, IsGoal isGoal);
+};
+
+// ----------------------------------------------------------------
+//  Name:           run
+//  Description:    Expands nodes in order of f until one is a goal.
+//  Arguments:      The arc visitor, estimate and goal test described
+//                  above.
+//  Return Value:   The goal reached, or invalidNodeId() if there is
+//                  none or visitArcs gave up. The path is in the
+//                  space.
+// ----------------------------------------------------------------
+template<class ArcType, class Space>
+template<class VisitArcs, class Estimate, class IsGoal>
+NodeId BestFirstSearch<ArcType, Space>::run(VisitArcs visitArcs, Estimate estimate, IsGoal isGoal)
+{
+	while (!m_open.empty())
+	{
+		OpenEntry top = m_open.top();
+		m_open.pop();
+		if (top.costDist != m_space.costDist(top.node))
+		{
+			continue;
+		}
+		if (isGoal(top.node))
+		{
+			return top.node;
+		}
+		Relax<Estimate> relax(*this, estimate, top.node, top.costDist);
+		if (!visitArcs(top.node, relax))
+		{
+			return invalidNodeId();
+		}
+	}
+	return invalidNodeId();
+}
+
+// ----------------------------------------------------------------
+//  Name:           IndexedGraph
+//  Description:    A read only layout of a graph for large maps.
+//                  Nodes are 32 bit indices and the arcs of node n
+//                  are the entries firstArc(n) to firstArc(n + 1)
+//                  of two flat arrays of targets and weights. Node
+//                  data and positions are cold and sit in their own
+//                  arrays, and search state lives in an
+//                  IndexedSearchSpace, so an expansion only touches
+//                  the offsets, the arcs and the search arrays.
+//                  Build it from a Graph, or with setNode()/addArc()
+//                  followed by finalise() when the map is too big to
+//                  hold as a Graph first.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class IndexedGraph {
+private:
+	// An open list entry. costDist is the cost the node had when it
+	// was pushed, which tells stale entries apart.
+	struct OpenEntry {
+		ArcType f;
+		ArcType costDist;
+		NodeId node;
+
+		bool operator>(OpenEntry const & other) const
+		{
+			return f > other.f;
+		}
+	};
+
+	struct PendingArc {
+		NodeId from;
+		NodeId to;
+		ArcType weight;
+	};
+
+	// Follows every arc, for BestFirstSearch.
+	struct AllArcs {
+		IndexedGraph const & graph;
+
+		template<class Relax>
+		bool operator()(NodeId node, Relax& relax) const
+		{
+			for (unsigned int arc = graph.m_firstArc[node]; arc < graph.m_firstArc[node + 1]; arc++)
+			{
+				relax(graph.m_arcTarget[arc], graph.m_arcWeight[arc]);
+			}
+			return true;
+		}
+	};
+
+// ----------------------------------------------------------------
+//  Description:    Topology. m_firstArc has one entry per node plus
+//                  one so that firstArc(n + 1) is always valid.
+// ----------------------------------------------------------------
+	std::vector<unsigned int> m_firstArc;
+	std::vector<NodeId> m_arcTarget;
+	std::vector<ArcType> m_arcWeight;
+
+// ----------------------------------------------------------------
+//  Description:    Cold payload, only read outside the search loop
+//                  (positions are read once per generated node for
+//                  the heuristic).
+// ----------------------------------------------------------------
+	std::vector<NodeType> m_data;
+	std::vector<GraphPosition> m_pos;
+
+	// Weight per unit of distance for the estimate, calibrated by
+	// finalise() (see HeuristicCalibration).
+	float m_scale;
+
+	std::vector<PendingArc> m_pending;
+
+	bool search(NodeId start, NodeId dest, bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const;
+	bool search(std::vector<SearchSource<ArcType> > const & sources, std::vector<NodeId> const & targets, bool useEstimate,
+		IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const;
+
+// ----------------------------------------------------------------
+//  Description:    The estimate towards the nearest of several
+//                  targets: the least estimate to any of them, or for
+//                  many targets the scaled distance to the box around
+//                  them, which is cheaper and still never too high.
+//                  Both are consistent, as each single estimate is.
+// ----------------------------------------------------------------
+	struct TargetEstimate {
+		std::vector<GraphPosition> targets;
+		GraphPosition boxMin;
+		GraphPosition boxMax;
+		float scale;
+
+		ArcType operator()(GraphPosition pos) const
+		{
+			float best = 0;
+			if (targets.size() <= 16)
+			{
+				for (size_t i = 0; i < targets.size(); i++)
+				{
+					float x = targets[i].x - pos.x;
+					float y = targets[i].y - pos.y;
+					float length = sqrt(x * x + y * y);
+					best = (i == 0) ? length : std::min(best, length);
+				}
+			}
+			else
+			{
+				float x = std::max(std::max(boxMin.x - pos.x, pos.x - boxMax.x), 0.0f);
+				float y = std::max(std::max(boxMin.y - pos.y, pos.y - boxMax.y), 0.0f);
+				best = sqrt(x * x + y * y);
+			}
+			return (ArcType)(scale * best);
+		}
+	};
+
+public:
+	IndexedGraph(NodeId nodes) : m_firstArc(nodes + 1, 0), m_data(nodes), m_pos(nodes), m_scale(0) {}
+
+	// Copies the nodes and arcs of a Graph, keeping its node indices.
+	IndexedGraph(Graph<NodeType, ArcType> const & graph)
+		: m_firstArc(graph.maxNodes() + 1, 0), m_data(graph.maxNodes()), m_pos(graph.maxNodes()), m_scale(0)
+	{
+		for (int i = 0; i < graph.maxNodes(); i++)
+		{
+			GraphNode<NodeType, ArcType>* pNode = graph.nodeArray()[i];
+			if (pNode != 0)
+			{
+				setNode(i, pNode->data(), pNode->getPos());
+				typename list<GraphArc<NodeType, ArcType> >::const_iterator iter = pNode->arcList().begin();
+				for (; iter != pNode->arcList().end(); ++iter)
+				{
+					addArc(i, (*iter).node()->index(), (*iter).weight());
+				}
+			}
+		}
+		finalise();
+	}
+
+	NodeId nodeCount() const
+	{
+		return (NodeId)m_data.size();
+	}
+
+	unsigned int arcCount() const
+	{
+		return (unsigned int)m_arcTarget.size();
+	}
+
+	NodeType const & data(NodeId node) const
+	{
+		return m_data[node];
+	}
+
+	GraphPosition pos(NodeId node) const
+	{
+		return m_pos[node];
+	}
+
+	unsigned int firstArc(NodeId node) const
+	{
+		return m_firstArc[node];
+	}
+
+	NodeId arcTarget(unsigned int arc) const
+	{
+		return m_arcTarget[arc];
+	}
+
+	ArcType arcWeight(unsigned int arc) const
+	{
+		return m_arcWeight[arc];
+	}
+
+	void setNode(NodeId node, NodeType const & data, GraphPosition pos)
+	{
+		m_data[node] = data;
+		m_pos[node] = pos;
+	}
+
+	// Queues an arc; arcs only become visible after finalise().
+	void addArc(NodeId from, NodeId to, ArcType weight)
+	{
+		PendingArc arc = { from, to, weight };
+		m_pending.push_back(arc);
+	}
+
+	// Makes room for that many more queued arcs, so a big import does
+	// not grow the queue by doubling.
+	void reserveArcs(size_t arcs)
+	{
+		m_pending.reserve(m_pending.size() + arcs);
+	}
+
+	void finalise();
+
+	// The straight line distance between two nodes in arc weight
+	// units, used as the A* heuristic.
+	ArcType estimate(NodeId from, NodeId to) const
+	{
+		float x = m_pos[to].x - m_pos[from].x;
+		float y = m_pos[to].y - m_pos[from].y;
+		return (ArcType)(m_scale * sqrt(x * x + y * y));
+	}
+
+	float heuristicScale() const
+	{
+		return m_scale;
+	}
+
+	// Overrides the calibrated scale until the next finalise().
+	void setHeuristicScale(float scale)
+	{
+		m_scale = scale;
+	}
+
+	int validateHeuristic(float scale, std::vector<HeuristicViolation<ArcType> >& violations) const;
+
+	bool aStar(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(start, dest, true, space, path);
+	}
+
+	bool ucs(NodeId start, NodeId dest, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(start, dest, false, space, path);
+	}
+
+	// Searches from any of the sources to whichever target is cheapest
+	// to reach, in one pass. The path runs from that target (first) to
+	// the source it was reached from (last), and its cost, offset
+	// included, is space.costDist(path.front()).
+	bool aStar(std::vector<SearchSource<ArcType> > const & sources, std::vector<NodeId> const & targets,
+		IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(sources, targets, true, space, path);
+	}
+
+	bool ucs(std::vector<SearchSource<ArcType> > const & sources, std::vector<NodeId> const & targets,
+		IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+	{
+		return search(sources, targets, false, space, path);
+	}
+
+	int ucs(NodeId start, std::vector<NodeId> const & targets, IndexedSearchSpace<ArcType>& space) const;
+	void ucs(NodeId start, IndexedSearchSpace<ArcType>& space) const;
+	IndexedGraph reversed() const;
+};
+
+// ----------------------------------------------------------------
+//  Name:           finalise
+//  Description:    Sorts the queued arcs by their source node into
+//                  the flat arc arrays (a counting sort, so arcs keep
+//                  the order they were added in), then calibrates the
+//                  estimate.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void IndexedGraph<NodeType, ArcType>::finalise()
+{
+	NodeId nodes = nodeCount();
+	std::vector<unsigned int> count(nodes + 1, 0);
+	for (NodeId n = 0; n < nodes; n++)
+	{
+		count[n] = m_firstArc[n + 1] - m_firstArc[n];
+	}
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		count[m_pending[i].from]++;
+	}
+
+	std::vector<unsigned int> firstArc(nodes + 1, 0);
+	for (NodeId n = 0; n < nodes; n++)
+	{
+		firstArc[n + 1] = firstArc[n] + count[n];
+	}
+
+	std::vector<NodeId> arcTarget(firstArc[nodes]);
+	std::vector<ArcType> arcWeight(firstArc[nodes]);
+	std::vector<unsigned int> next(firstArc.begin(), firstArc.end() - 1);
+	for (NodeId n = 0; n < nodes; n++)
+	{
+		for (unsigned int arc = m_firstArc[n]; arc < m_firstArc[n + 1]; arc++)
+		{
+			arcTarget[next[n]] = m_arcTarget[arc];
+			arcWeight[next[n]] = m_arcWeight[arc];
+			next[n]++;
+		}
+	}
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		NodeId from = m_pending[i].from;
+		arcTarget[next[from]] = m_pending[i].to;
+		arcWeight[next[from]] = m_pending[i].weight;
+		next[from]++;
+	}
+
+	m_firstArc.swap(firstArc);
+	m_arcTarget.swap(arcTarget);
+	m_arcWeight.swap(arcWeight);
+	std::vector<PendingArc>().swap(m_pending);
+
+	HeuristicCalibration calibration;
+	for (NodeId n = 0; n < nodes; n++)
+	{
+		for (unsigned int arc = m_firstArc[n]; arc < m_firstArc[n + 1]; arc++)
+		{
+			calibration.addArc(m_pos[n], m_pos[m_arcTarget[arc]], m_arcWeight[arc]);
+		}
+	}
+	m_scale = calibration.scale();
+}
+
+// ----------------------------------------------------------------
+//  Name:           validateHeuristic
+//  Description:    Checks every arc against a scale, as
+//                  Graph::validateHeuristic does.
+//  Arguments:      The scale and the vector the arcs that break
+//                  consistency are added to.
+//  Return Value:   The number of arcs added.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+int IndexedGraph<NodeType, ArcType>::validateHeuristic(float scale, std::vector<HeuristicViolation<ArcType> >& violations) const
+{
+	int found = 0;
+	for (NodeId n = 0; n < nodeCount(); n++)
+	{
+		for (unsigned int arc = m_firstArc[n]; arc < m_firstArc[n + 1]; arc++)
+		{
+			GraphPosition from = m_pos[n];
+			GraphPosition to = m_pos[m_arcTarget[arc]];
+			if (HeuristicCalibration::violates(from, to, m_arcWeight[arc], scale))
+			{
+				HeuristicViolation<ArcType> violation = { (int)n, (int)m_arcTarget[arc], m_arcWeight[arc], scale * HeuristicCalibration::length(from, to) };
+				violations.push_back(violation);
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
+// ----------------------------------------------------------------
+//  Name:           reversed
+//  Description:    Makes a copy of the graph with every arc turned
+//                  around, for searching backwards from a goal.
+//  Arguments:      None.
+//  Return Value:   The reversed graph.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+IndexedGraph<NodeType, ArcType> IndexedGraph<NodeType, ArcType>::reversed() const
+{
+	IndexedGraph reverse(nodeCount());
+	for (NodeId n = 0; n < nodeCount(); n++)
+	{
+		reverse.setNode(n, m_data[n], m_pos[n]);
+		for (unsigned int arc = m_firstArc[n]; arc < m_firstArc[n + 1]; arc++)
+		{
+			reverse.addArc(m_arcTarget[arc], n, m_arcWeight[arc]);
+		}
+	}
+	reverse.finalise();
+	return reverse;
+}
+
+// ----------------------------------------------------------------
+//  Name:           ucs
+//  Description:    One to many uniform cost search. Stops as soon as
+//                  every target has been settled, so the search only
+//                  grows as far as the furthest target.
+//  Arguments:      The start, the targets and the search space, which
+//                  holds the costs and the search tree afterwards.
+//  Return Value:   The number of distinct targets that were reached.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+int IndexedGraph<NodeType, ArcType>::ucs(NodeId start, std::vector<NodeId> const & targets, IndexedSearchSpace<ArcType>& space) const
+{
+	std::vector<NodeId> sorted(targets);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+	int remaining = (int)sorted.size();
+
+	space.reset(nodeCount());
+	BestFirstSearch<ArcType, IndexedSearchSpace<ArcType> > bestFirst(space);
+	bestFirst.start(start, 0, 0);
+	if (remaining > 0)
+	{
+		AllArcs arcs = { *this };
+		bestFirst.run(arcs, [](NodeId) { return ArcType(); }, [&](NodeId node) -> bool
+		{
+			// the search is over once the last target is settled.
+			return std::binary_search(sorted.begin(), sorted.end(), node) && --remaining == 0;
+		});
+	}
+	return (int)sorted.size() - remaining;
+}
+
+// ----------------------------------------------------------------
+//  Name:           ucs
+//  Description:    Uniform cost search from the start to every node
+//                  it can reach.
+//  Arguments:      The start and the search space, which holds the
+//                  full shortest path tree afterwards.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void IndexedGraph<NodeType, ArcType>::ucs(NodeId start, IndexedSearchSpace<ArcType>& space) const
+{
+	std::vector<NodeId> path;
+	search(start, invalidNodeId(), false, space, path);
+}
+
+// ----------------------------------------------------------------
+//  Name:           search
+//  Description:    A* (or uniform cost search when useEstimate is
+//                  false) from start to dest. The open list holds a
+//                  node again each time its cost improves and stale
+//                  entries are skipped, so no decrease-key is needed.
+//                  A node's arcs are relaxed together by relaxArcs,
+//                  which uses vector instructions where the build
+//                  allows, and only the improved ones come back.
+//  Arguments:      The start and destination (invalidNodeId() to
+//                  search the whole graph), whether to use the
+//                  straight line estimate, the search space to work
+//                  in and the vector the path is written to.
+//  Return Value:   true if a path was found.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool IndexedGraph<NodeType, ArcType>::search(NodeId start, NodeId dest, bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+{
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > open;
+	space.reset(nodeCount());
+	space.set(start, 0, invalidNodeId());
+	OpenEntry first = { useEstimate ? estimate(start, dest) : 0, 0, start };
+	open.push(first);
+
+	ArcBatch<ArcType> batch;
+	batch.pPos = &m_pos[0];
+	batch.goal = useEstimate ? m_pos[dest] : GraphPosition();
+	batch.scale = m_scale;
+	batch.useEstimate = useEstimate;
+	batch.nodes = nodeCount();
+	std::vector<RelaxedArc<ArcType> > relaxed;
+
+	while (!open.empty())
+	{
+		OpenEntry top = open.top();
+		open.pop();
+
+		NodeId current = top.node;
+		ArcType costDist = top.costDist;
+		// skip entries left behind when the node's cost improved.
+		if (costDist != space.costDist(current))
+		{
+			continue;
+		}
+		if (current == dest)
+		{
+			space.path(dest, path);
+			return true;
+		}
+
+		batch.count = m_firstArc[current + 1] - m_firstArc[current];
+		if (batch.count == 0)
+		{
+			continue;
+		}
+		batch.pTarget = &m_arcTarget[m_firstArc[current]];
+		batch.pWeight = &m_arcWeight[m_firstArc[current]];
+		batch.costDist = costDist;
+		batch.pChildCost = space.costArray();
+		batch.pStamp = space.stampArray();
+		batch.generation = space.generation();
+		if (relaxed.size() < batch.count)
+		{
+			relaxed.resize(batch.count);
+		}
+
+		int improved = relaxArcs(batch, &relaxed[0]);
+		for (int i = 0; i < improved; i++)
+		{
+			// a later arc to the same child may already have done better.
+			if (relaxed[i].costDist < space.costDist(relaxed[i].node))
+			{
+				space.set(relaxed[i].node, relaxed[i].costDist, current);
+				OpenEntry entry = { relaxed[i].f, relaxed[i].costDist, relaxed[i].node };
+				open.push(entry);
+			}
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           search
+//  Description:    Multi source, multi target A* (or uniform cost
+//                  search when useEstimate is false). Every source
+//                  starts on the open list at its offset, so the
+//                  search grows from all of them at once, and it stops
+//                  at the first target taken off the open list, which
+//                  is the cheapest target to reach from any source.
+//                  This does the work of one search per source and
+//                  target pair in a single pass.
+//  Arguments:      The sources, the targets, whether to use the
+//                  estimate, the search space to work in and the
+//                  vector the path is written to.
+//  Return Value:   true if any target was reached.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool IndexedGraph<NodeType, ArcType>::search(std::vector<SearchSource<ArcType> > const & sources, std::vector<NodeId> const & targets,
+	bool useEstimate, IndexedSearchSpace<ArcType>& space, std::vector<NodeId>& path) const
+{
+	if (targets.empty())
+	{
+		return false;
+	}
+	std::vector<NodeId> sorted(targets);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	TargetEstimate estimate;
+	estimate.scale = useEstimate ? m_scale : 0;
+	estimate.boxMin = estimate.boxMax = m_pos[sorted[0]];
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		GraphPosition pos = m_pos[sorted[i]];
+		estimate.targets.push_back(pos);
+		estimate.boxMin.x = std::min(estimate.boxMin.x, pos.x);
+		estimate.boxMin.y = std::min(estimate.boxMin.y, pos.y);
+		estimate.boxMax.x = std::max(estimate.boxMax.x, pos.x);
+		estimate.boxMax.y = std::max(estimate.boxMax.y, pos.y);
+	}
+
+	space.reset(nodeCount());
+	BestFirstSearch<ArcType, IndexedSearchSpace<ArcType> > bestFirst(space);
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		NodeId node = sources[i].node;
+		bestFirst.start(node, sources[i].offset, sources[i].offset + estimate(m_pos[node]));
+	}
+
+	AllArcs arcs = { *this };
+	NodeId goal = bestFirst.run(arcs, [&](NodeId node) { return estimate(m_pos[node]); },
+		[&](NodeId node) { return std::binary_search(sorted.begin(), sorted.end(), node); });
+	if (goal == invalidNodeId())
+	{
+		return false;
+	}
+	space.path(goal, path);
+	return true;
+}
+
+#endif
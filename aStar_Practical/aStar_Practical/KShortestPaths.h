@@ -0,0 +1,294 @@
+#ifndef KSHORTESTPATHS_H
+#define KSHORTESTPATHS_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           RankedPath
+//  Description:    One of the paths returned by kShortestPaths, goal
+//                  first like IndexedGraph::aStar, with its cost.
+// ----------------------------------------------------------------
+template<class ArcType>
+struct RankedPath {
+	ArcType cost;
+	std::vector<NodeId> nodes;
+};
+
+// ----------------------------------------------------------------
+//  Name:           SpurSearch
+//  Description:    The A* search Yen's algorithm runs from each spur
+//                  node. Some nodes and arcs are banned for the
+//                  search; they are kept in the SpurSearch instead of
+//                  being removed from the graph, so any number of
+//                  spur searches can run over one graph at once.
+//                  The estimate is the exact cost to the goal on the
+//                  whole graph, taken from one search backwards from
+//                  the goal. Banning things can only make paths
+//                  longer, so it stays admissible and the search
+//                  goes almost straight to the goal.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class SpurSearch {
+private:
+	// Follows the arcs the spur may take, for BestFirstSearch.
+	struct AllowedArcs {
+		SpurSearch const & search;
+
+		template<class Relax>
+		bool operator()(NodeId node, Relax& relax) const
+		{
+			IndexedGraph<NodeType, ArcType> const & graph = search.m_graph;
+			for (unsigned int arc = graph.firstArc(node); arc < graph.firstArc(node + 1); arc++)
+			{
+				NodeId child = graph.arcTarget(arc);
+				// nodes that cannot reach the goal at all are never worth a visit.
+				if (!search.m_bannedNode[child] && search.m_toGoal.reached(child) && !search.arcBanned(node, child))
+				{
+					relax(child, graph.arcWeight(arc));
+				}
+			}
+			return true;
+		}
+	};
+
+	IndexedGraph<NodeType, ArcType> const & m_graph;
+	IndexedSearchSpace<ArcType> const & m_toGoal;
+	IndexedSearchSpace<ArcType> m_space;
+
+	std::vector<char> m_bannedNode;
+	std::vector<std::pair<NodeId, NodeId> > m_bannedArcs;
+	ArcType m_cost;
+
+	bool arcBanned(NodeId from, NodeId to) const
+	{
+		for (size_t i = 0; i < m_bannedArcs.size(); i++)
+		{
+			if (m_bannedArcs[i].first == from && m_bannedArcs[i].second == to)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+public:
+	SpurSearch(IndexedGraph<NodeType, ArcType> const & graph, IndexedSearchSpace<ArcType> const & toGoal)
+		: m_graph(graph), m_toGoal(toGoal), m_bannedNode(graph.nodeCount(), false), m_cost(0)
+	{
+	}
+
+	// The cost of the path found by the last successful run().
+	ArcType cost() const
+	{
+		return m_cost;
+	}
+
+	void banNode(NodeId node)
+	{
+		m_bannedNode[node] = true;
+	}
+
+	void banArc(NodeId from, NodeId to)
+	{
+		m_bannedArcs.push_back(std::make_pair(from, to));
+	}
+
+	// Lifts every ban, ready for the next spur.
+	void clearBans(std::vector<NodeId> const & nodes)
+	{
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			m_bannedNode[nodes[i]] = false;
+		}
+		m_bannedArcs.clear();
+	}
+
+// ----------------------------------------------------------------
+//  Name:           run
+//  Description:    Finds the cheapest path from the spur node to the
+//                  goal that avoids the banned nodes and arcs.
+//  Arguments:      The spur node, the goal and the vector the path
+//                  is written to, goal first.
+//  Return Value:   true if there is such a path.
+// ----------------------------------------------------------------
+	bool run(NodeId start, NodeId goal, std::vector<NodeId>& path)
+	{
+		m_space.reset(m_graph.nodeCount());
+		BestFirstSearch<ArcType, IndexedSearchSpace<ArcType> > bestFirst(m_space);
+		bestFirst.start(start, 0, m_toGoal.costDist(start));
+		IndexedSearchSpace<ArcType> const & toGoal = m_toGoal;
+		AllowedArcs arcs = { *this };
+		if (bestFirst.run(arcs, [&](NodeId child) { return toGoal.costDist(child); },
+			[&](NodeId node) { return node == goal; }) == invalidNodeId())
+		{
+			return false;
+		}
+		m_cost = m_space.costDist(goal);
+		m_space.path(goal, path);
+		return true;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           kShortestPaths
+//  Description:    Yen's algorithm for the k cheapest loopless paths.
+//                  Each new path is found by branching off the last
+//                  one at every node on it (the spur node), keeping
+//                  the route up to that node (the root) and banning
+//                  the arcs other found paths take from the same
+//                  root. The spur searches for one round are shared
+//                  out between threads, and the graph is never
+//                  changed.
+//  Arguments:      The graph, start, goal, how many paths to find,
+//                  the number of threads to use and the vector the
+//                  paths are written to, cheapest first.
+//  Return Value:   The number of paths found, which is less than k if
+//                  there are not k loopless paths.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+int kShortestPaths(IndexedGraph<NodeType, ArcType> const & graph, NodeId start, NodeId goal, int k, int threads,
+	std::vector<RankedPath<ArcType> >& paths)
+{
+	// costs to the goal from everywhere, for the spur search estimate.
+	IndexedGraph<NodeType, ArcType> reverse = graph.reversed();
+	IndexedSearchSpace<ArcType> toGoal;
+	reverse.ucs(goal, toGoal);
+	if (!toGoal.reached(start) || k <= 0)
+	{
+		return 0;
+	}
+
+	// paths are kept start first while the algorithm runs.
+	std::vector<RankedPath<ArcType> > found;
+	std::vector<RankedPath<ArcType> > candidates;
+	{
+		SpurSearch<NodeType, ArcType> search(graph, toGoal);
+		RankedPath<ArcType> first;
+		search.run(start, goal, first.nodes);
+		std::reverse(first.nodes.begin(), first.nodes.end());
+		first.cost = toGoal.costDist(start);
+		found.push_back(first);
+	}
+
+	while ((int)found.size() < k)
+	{
+		std::vector<NodeId> const & last = found.back().nodes;
+		int spurs = (int)last.size() - 1;
+
+		// cost of the root up to each spur node. A step may have
+		// parallel arcs, and the searches always took the cheapest.
+		std::vector<ArcType> rootCost(last.size(), 0);
+		for (int i = 1; i < (int)last.size(); i++)
+		{
+			ArcType weight = std::numeric_limits<ArcType>::max();
+			for (unsigned int arc = graph.firstArc(last[i - 1]); arc < graph.firstArc(last[i - 1] + 1); arc++)
+			{
+				if (graph.arcTarget(arc) == last[i])
+				{
+					weight = std::min(weight, graph.arcWeight(arc));
+				}
+			}
+			rootCost[i] = rootCost[i - 1] + weight;
+		}
+
+		std::vector<RankedPath<ArcType> > spurPaths(spurs);
+		std::vector<char> spurFound(spurs, false);
+		std::atomic<int> next(0);
+
+		std::function<void()> work = [&]()
+		{
+			SpurSearch<NodeType, ArcType> search(graph, toGoal);
+			for (int i = next++; i < spurs; i = next++)
+			{
+				std::vector<NodeId> rootNodes(last.begin(), last.begin() + i);
+				for (size_t n = 0; n < rootNodes.size(); n++)
+				{
+					search.banNode(rootNodes[n]);
+				}
+				for (size_t p = 0; p < found.size(); p++)
+				{
+					std::vector<NodeId> const & other = found[p].nodes;
+					if ((int)other.size() > i + 1 && std::equal(last.begin(), last.begin() + i + 1, other.begin()))
+					{
+						search.banArc(other[i], other[i + 1]);
+					}
+				}
+
+				std::vector<NodeId> spur;
+				if (search.run(last[i], goal, spur))
+				{
+					RankedPath<ArcType>& path = spurPaths[i];
+					path.nodes = rootNodes;
+					path.nodes.insert(path.nodes.end(), spur.rbegin(), spur.rend());
+					path.cost = rootCost[i] + search.cost();
+					spurFound[i] = true;
+				}
+				search.clearBans(rootNodes);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (int t = 1; t < threads && t < spurs; t++)
+		{
+			workers.push_back(std::thread(work));
+		}
+		work();
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+
+		for (int i = 0; i < spurs; i++)
+		{
+			if (!spurFound[i])
+			{
+				continue;
+			}
+			bool seen = false;
+			for (size_t c = 0; c < candidates.size() && !seen; c++)
+			{
+				seen = candidates[c].nodes == spurPaths[i].nodes;
+			}
+			for (size_t p = 0; p < found.size() && !seen; p++)
+			{
+				seen = found[p].nodes == spurPaths[i].nodes;
+			}
+			if (!seen)
+			{
+				candidates.push_back(spurPaths[i]);
+			}
+		}
+
+		if (candidates.empty())
+		{
+			break;
+		}
+		size_t best = 0;
+		for (size_t c = 1; c < candidates.size(); c++)
+		{
+			if (candidates[c].cost < candidates[best].cost)
+			{
+				best = c;
+			}
+		}
+		found.push_back(candidates[best]);
+		candidates.erase(candidates.begin() + best);
+	}
+
+	for (size_t p = 0; p < found.size(); p++)
+	{
+		std::reverse(found[p].nodes.begin(), found[p].nodes.end());
+		paths.push_back(found[p]);
+	}
+	return (int)found.size();
+}
+
+#endif
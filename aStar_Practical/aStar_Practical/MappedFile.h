@@ -0,0 +1,172 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------
+//  Name:           MappedFile
+//  Description:    A whole file mapped read only into memory. Pages
+//                  are only read from disk when they are first
+//                  touched, and the system can drop them again under
+//                  memory pressure, so a mapping costs address space
+//                  rather than RAM.
+// ----------------------------------------------------------------
+class MappedFile {
+private:
+	char const * m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
+#endif
+
+	MappedFile(MappedFile const &);
+	MappedFile& operator=(MappedFile const &);
+
+public:
+	MappedFile() : m_pData(0), m_size(0)
+#ifdef _WIN32
+		, m_file(INVALID_HANDLE_VALUE), m_mapping(0)
+#endif
+	{
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	bool isOpen() const
+	{
+		return m_pData != 0;
+	}
+
+	char const * data() const
+	{
+		return m_pData;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+// ----------------------------------------------------------------
+//  Name:           open
+//  Description:    Maps a file, closing any file mapped before.
+//  Arguments:      The file name.
+//  Return Value:   false if the file cannot be opened or is empty.
+// ----------------------------------------------------------------
+	bool open(std::string const & fileName)
+	{
+		close();
+#ifdef _WIN32
+		m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, 0);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+		if (m_mapping == 0)
+		{
+			close();
+			return false;
+		}
+		m_pData = (char const *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		m_size = (size_t)size.QuadPart;
+#else
+		int file = ::open(fileName.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+		{
+			void* pMap = mmap(0, (size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0);
+			if (pMap != MAP_FAILED)
+			{
+				m_pData = (char const *)pMap;
+				m_size = (size_t)info.st_size;
+			}
+		}
+		// the mapping stays valid after the file is closed.
+		::close(file);
+#endif
+		if (m_pData == 0)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (m_pData != 0)
+		{
+			UnmapViewOfFile(m_pData);
+		}
+		if (m_mapping != 0)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = 0;
+		}
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (m_pData != 0)
+		{
+			munmap((void*)m_pData, m_size);
+		}
+#endif
+		m_pData = 0;
+		m_size = 0;
+	}
+
+	// Asks the system to start reading the whole file in the
+	// background, ahead of it being touched.
+	void willNeed() const
+	{
+		if (m_pData == 0)
+		{
+			return;
+		}
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+		WIN32_MEMORY_RANGE_ENTRY range = { (void*)m_pData, m_size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+		madvise((void*)m_pData, m_size, MADV_WILLNEED);
+#endif
+	}
+};
+
+#endif
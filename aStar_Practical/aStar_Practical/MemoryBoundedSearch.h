@@ -0,0 +1,630 @@
+#ifndef MEMORYBOUNDEDSEARCH_H
+#define MEMORYBOUNDEDSEARCH_H
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           MemoryBoundedSearch
+//  Description:    Shortest path searches that never hold more than
+//                  a fixed number of bytes of search state, however
+//                  big the graph, for machines where the per node
+//                  arrays and open list of a normal A* do not fit.
+//                  Everything is allocated once by the constructor
+//                  and reused by every query, so peakBytes() is known
+//                  before the first query runs.
+//                  idaStar is iterative deepening A*: depth first
+//                  searches bounded by an f limit that is raised to
+//                  the smallest f cut off last time. It keeps only
+//                  the current path plus a fixed size transposition
+//                  table of the cheapest cost each node was reached
+//                  at in this iteration, which prunes repeat visits
+//                  (and cycles) without growing.
+//                  smaStar is simplified memory bounded A*: best
+//                  first like A*, but when the node pool is full the
+//                  leaf with the highest f is dropped and its f kept
+//                  in its parent, which regenerates it if everything
+//                  else turns out worse. A child already held at no
+//                  more cost elsewhere in the tree is not generated
+//                  again, so on maps with many routes to each node the
+//                  pool is not filled with copies.
+//                  Both need an admissible estimate (as A* does) to
+//                  return the cheapest path. When the budget is too
+//                  small to hold a path that might be cheaper than the
+//                  one found, they fail rather than return a path that
+//                  may not be the cheapest. They also give up after a
+//                  set number of expansions, since with a small table
+//                  or pool a search towards an unreachable goal can
+//                  revisit nodes for a very long time. gaveUp() tells
+//                  these failures from there being no path.
+//                  Paths are written goal first, as by aStar.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class MemoryBoundedSearch {
+private:
+	// idaStar state.
+	struct TableEntry {
+		NodeId node;
+		unsigned int iteration;
+		ArcType costDist;
+	};
+
+	struct Frame {
+		NodeId node;
+		unsigned int nextArc;
+		ArcType costDist;
+	};
+
+// ----------------------------------------------------------------
+//  Description:    A node held by smaStar. Children in memory are a
+//                  linked list through firstChild and nextSibling,
+//                  and nodes whose ids hash alike through nextSame.
+//                  nextArc is the next arc of the node to generate a
+//                  child from. forgotten is the lowest f of the
+//                  children dropped and not yet regenerated, and
+//                  forgottenThisPass the same for those dropped since
+//                  the node last started walking its arcs, which
+//                  becomes forgotten when the walk ends. generated is
+//                  set once every arc has been walked, from when the
+//                  node's f can be backed up from its children.
+// ----------------------------------------------------------------
+	struct SmaNode {
+		NodeId node;
+		unsigned int nextArc;
+		int parent;
+		int firstChild;
+		int nextSibling;
+		int nextSame;
+		int depth;
+		ArcType costDist;
+		ArcType f;
+		ArcType forgotten;
+		ArcType forgottenThisPass;
+		bool generated;
+		bool open;
+	};
+
+	// The open set is ordered by f, deepest first among equals, so
+	// the best node is at the front and the worst at the back.
+	struct OpenKey {
+		ArcType f;
+		int depth;
+		int index;
+
+		bool operator<(OpenKey const & other) const
+		{
+			if (f != other.f)
+			{
+				return f < other.f;
+			}
+			if (depth != other.depth)
+			{
+				return depth > other.depth;
+			}
+			return index < other.index;
+		}
+	};
+
+	IndexedGraph<NodeType, ArcType> const & m_graph;
+	size_t m_budget;
+
+	std::vector<TableEntry> m_table;
+	std::vector<Frame> m_stack;
+	unsigned int m_iteration;
+
+	std::vector<SmaNode> m_pool;
+	std::vector<int> m_free;
+	std::vector<int> m_sameHash;
+	std::set<OpenKey> m_open;
+
+	ArcType m_cost;
+	int m_expanded;
+	int m_maxExpanded;
+	bool m_gaveUp;
+	ArcType m_cutOff;
+
+	static ArcType infinity()
+	{
+		return numeric_limits<ArcType>::max();
+	}
+
+	// What one smaStar node costs: the node, its hash chain head and
+	// free list slot, and its open set entry with the set's own per
+	// entry overhead.
+	static size_t smaNodeBytes()
+	{
+		return sizeof(SmaNode) + 2 * sizeof(int) + sizeof(OpenKey) + 4 * sizeof(void*);
+	}
+
+	int& sameHash(NodeId node)
+	{
+		return m_sameHash[(size_t)(node * 2654435761u) % m_sameHash.size()];
+	}
+
+	TableEntry& tableEntry(NodeId node)
+	{
+		return m_table[(size_t)(node * 2654435761u) % m_table.size()];
+	}
+
+	void open(int index);
+	void close(int index);
+	void setF(int index, ArcType f);
+	void backUp(int index);
+	int newNode(NodeId node, int parent, ArcType costDist, ArcType f);
+	void forget(int index, ArcType f);
+	bool held(NodeId node, ArcType costDist);
+	bool evict(int keep);
+
+public:
+	// idaStar gets half the budget for the table and half for the
+	// path; smaStar gets all of it for nodes. A query fails once it
+	// has expanded maxExpanded nodes.
+	MemoryBoundedSearch(IndexedGraph<NodeType, ArcType> const & graph, size_t budgetBytes,
+		int maxExpanded = std::numeric_limits<int>::max())
+		: m_graph(graph), m_budget(budgetBytes), m_iteration(0), m_cost(0), m_expanded(0),
+		m_maxExpanded(maxExpanded), m_gaveUp(false), m_cutOff(0)
+	{
+		m_table.resize(std::max(budgetBytes / 2 / sizeof(TableEntry), (size_t)1));
+		m_stack.reserve(std::max(budgetBytes / 2 / sizeof(Frame), (size_t)2));
+		m_pool.resize(std::max(budgetBytes / smaNodeBytes(), (size_t)2));
+		m_free.reserve(m_pool.size());
+		m_sameHash.resize(m_pool.size());
+		for (size_t i = 0; i < m_table.size(); i++)
+		{
+			m_table[i].iteration = 0;
+		}
+	}
+
+	// The most memory a query can use, whichever search it is.
+	size_t peakBytes() const
+	{
+		return std::max(m_table.size() * sizeof(TableEntry) + m_stack.capacity() * sizeof(Frame),
+			m_pool.size() * smaNodeBytes());
+	}
+
+	// The cost of the last path found.
+	ArcType cost() const
+	{
+		return m_cost;
+	}
+
+	// Nodes expanded by the last query, counting repeats.
+	int expanded() const
+	{
+		return m_expanded;
+	}
+
+	// Whether the last query failed for lack of budget or expansions,
+	// rather than because there is no path.
+	bool gaveUp() const
+	{
+		return m_gaveUp;
+	}
+
+	bool idaStar(NodeId start, NodeId dest, std::vector<NodeId>& path);
+	bool smaStar(NodeId start, NodeId dest, std::vector<NodeId>& path);
+};
+
+// ----------------------------------------------------------------
+//  Name:           idaStar
+//  Description:    Iterative deepening A*. Each iteration is a depth
+//                  first search over an explicit stack that skips nodes
+//                  the table shows were already reached this iteration
+//                  at no more cost, and cuts off nodes with f above
+//                  the limit. Table entries from older iterations
+//                  count as empty, and a clash simply overwrites, so
+//                  the table only ever saves work. If the path grows
+//                  past the stack's share of the budget the branch is
+//                  cut off too, and a path found later that costs more
+//                  than the lowest f cut off that way is not returned.
+//                  An unreachable goal is only known once an iteration
+//                  cuts nothing off, which on a big component with a
+//                  small table can take until the expansion limit.
+//  Arguments:      The start and destination and the vector the path
+//                  is written to.
+//  Return Value:   true if a path was found.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool MemoryBoundedSearch<NodeType, ArcType>::idaStar(NodeId start, NodeId dest, std::vector<NodeId>& path)
+{
+	m_expanded = 0;
+	m_gaveUp = false;
+	m_cutOff = infinity();
+	ArcType limit = m_graph.estimate(start, dest);
+	while (true)
+	{
+		// the stamps wrapping round would bring back old entries.
+		if (++m_iteration == 0)
+		{
+			for (size_t i = 0; i < m_table.size(); i++)
+			{
+				m_table[i].iteration = 0;
+			}
+			m_iteration = 1;
+		}
+		ArcType nextLimit = infinity();
+
+		m_stack.clear();
+		Frame first = { start, m_graph.firstArc(start), 0 };
+		m_stack.push_back(first);
+		TableEntry& entry = tableEntry(start);
+		entry.node = start;
+		entry.iteration = m_iteration;
+		entry.costDist = 0;
+
+		while (!m_stack.empty())
+		{
+			Frame& top = m_stack.back();
+			if (top.node == dest)
+			{
+				if (top.costDist > m_cutOff)
+				{
+					m_gaveUp = true;
+					return false;
+				}
+				m_cost = top.costDist;
+				for (size_t i = m_stack.size(); i > 0; i--)
+				{
+					path.push_back(m_stack[i - 1].node);
+				}
+				return true;
+			}
+			if (top.nextArc == m_graph.firstArc(top.node + 1))
+			{
+				m_stack.pop_back();
+				continue;
+			}
+			unsigned int arc = top.nextArc++;
+			NodeId child = m_graph.arcTarget(arc);
+			ArcType dist = top.costDist + m_graph.arcWeight(arc);
+			// checked before the limit, so a node already searched from
+			// does not hold the next limit down.
+			TableEntry& seen = tableEntry(child);
+			if (seen.iteration == m_iteration && seen.node == child && seen.costDist <= dist)
+			{
+				continue;
+			}
+			ArcType f = dist + m_graph.estimate(child, dest);
+			if (f > limit)
+			{
+				nextLimit = std::min(nextLimit, f);
+				continue;
+			}
+			if (m_stack.size() == m_stack.capacity())
+			{
+				m_cutOff = std::min(m_cutOff, f);
+				continue;
+			}
+			if (m_expanded == m_maxExpanded)
+			{
+				m_gaveUp = true;
+				return false;
+			}
+			seen.node = child;
+			seen.iteration = m_iteration;
+			seen.costDist = dist;
+			Frame next = { child, m_graph.firstArc(child), dist };
+			m_stack.push_back(next);
+			m_expanded++;
+		}
+
+		if (nextLimit == infinity())
+		{
+			m_gaveUp = (m_cutOff != infinity());
+			return false;
+		}
+		limit = nextLimit;
+	}
+}
+
+template<class NodeType, class ArcType>
+void MemoryBoundedSearch<NodeType, ArcType>::open(int index)
+{
+	SmaNode& node = m_pool[index];
+	if (!node.open)
+	{
+		OpenKey key = { node.f, node.depth, index };
+		m_open.insert(key);
+		node.open = true;
+	}
+}
+
+template<class NodeType, class ArcType>
+void MemoryBoundedSearch<NodeType, ArcType>::close(int index)
+{
+	SmaNode& node = m_pool[index];
+	if (node.open)
+	{
+		OpenKey key = { node.f, node.depth, index };
+		m_open.erase(key);
+		node.open = false;
+	}
+}
+
+template<class NodeType, class ArcType>
+void MemoryBoundedSearch<NodeType, ArcType>::setF(int index, ArcType f)
+{
+	bool wasOpen = m_pool[index].open;
+	close(index);
+	m_pool[index].f = f;
+	if (wasOpen)
+	{
+		open(index);
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           backUp
+//  Description:    Once every arc of a node has been generated its f
+//                  can rise to the lowest f among its children, in
+//                  memory or forgotten; the change is passed on to
+//                  each ancestor that has also been fully generated.
+//  Arguments:      The node.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void MemoryBoundedSearch<NodeType, ArcType>::backUp(int index)
+{
+	while (index >= 0)
+	{
+		SmaNode& node = m_pool[index];
+		if (!node.generated)
+		{
+			return;
+		}
+		ArcType best = node.forgotten;
+		for (int child = node.firstChild; child >= 0; child = m_pool[child].nextSibling)
+		{
+			best = std::min(best, m_pool[child].f);
+		}
+		if (best == node.f)
+		{
+			return;
+		}
+		setF(index, best);
+		index = node.parent;
+	}
+}
+
+template<class NodeType, class ArcType>
+int MemoryBoundedSearch<NodeType, ArcType>::newNode(NodeId node, int parent, ArcType costDist, ArcType f)
+{
+	int index = m_free.back();
+	m_free.pop_back();
+	SmaNode& added = m_pool[index];
+	added.node = node;
+	added.nextArc = m_graph.firstArc(node);
+	added.parent = parent;
+	added.firstChild = -1;
+	added.nextSibling = -1;
+	added.nextSame = sameHash(node);
+	sameHash(node) = index;
+	added.depth = 0;
+	added.costDist = costDist;
+	added.f = f;
+	added.forgotten = infinity();
+	added.forgottenThisPass = infinity();
+	added.generated = false;
+	added.open = false;
+	if (parent >= 0)
+	{
+		added.depth = m_pool[parent].depth + 1;
+		added.nextSibling = m_pool[parent].firstChild;
+		m_pool[parent].firstChild = index;
+	}
+	open(index);
+	return index;
+}
+
+// Records the f of a child of the node that has been dropped.
+template<class NodeType, class ArcType>
+void MemoryBoundedSearch<NodeType, ArcType>::forget(int index, ArcType f)
+{
+	m_pool[index].forgotten = std::min(m_pool[index].forgotten, f);
+	m_pool[index].forgottenThisPass = std::min(m_pool[index].forgottenThisPass, f);
+}
+
+// Whether a node is already in memory at no more than the given cost.
+template<class NodeType, class ArcType>
+bool MemoryBoundedSearch<NodeType, ArcType>::held(NodeId node, ArcType costDist)
+{
+	for (int index = sameHash(node); index >= 0; index = m_pool[index].nextSame)
+	{
+		if (m_pool[index].node == node && m_pool[index].costDist <= costDist)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           evict
+//  Description:    Drops the open leaf with the highest f (the
+//                  shallowest among equals), other than the root and
+//                  the given node. Its parent remembers its f and goes
+//                  back on the open set so it can regenerate it.
+//  Arguments:      The node that must stay.
+//  Return Value:   false if there was no leaf that could be dropped.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool MemoryBoundedSearch<NodeType, ArcType>::evict(int keep)
+{
+	for (typename std::set<OpenKey>::reverse_iterator iter = m_open.rbegin(); iter != m_open.rend(); ++iter)
+	{
+		int index = iter->index;
+		SmaNode& leaf = m_pool[index];
+		if (index == keep || leaf.parent < 0 || leaf.firstChild >= 0)
+		{
+			continue;
+		}
+		close(index);
+		SmaNode& parent = m_pool[leaf.parent];
+		if (parent.firstChild == index)
+		{
+			parent.firstChild = leaf.nextSibling;
+		}
+		else
+		{
+			int child = parent.firstChild;
+			while (m_pool[child].nextSibling != index)
+			{
+				child = m_pool[child].nextSibling;
+			}
+			m_pool[child].nextSibling = leaf.nextSibling;
+		}
+		int* pSame = &sameHash(leaf.node);
+		while (*pSame != index)
+		{
+			pSame = &m_pool[*pSame].nextSame;
+		}
+		*pSame = leaf.nextSame;
+		forget(leaf.parent, leaf.f);
+		open(leaf.parent);
+		m_free.push_back(index);
+		return true;
+	}
+	return false;
+}
+
+// ----------------------------------------------------------------
+//  Name:           smaStar
+//  Description:    Simplified memory bounded A*. The best open node
+//                  generates one child per step, with f never below
+//                  its parent's. A child that could not be stored even
+//                  at the end of a full path gets f infinity, and the
+//                  goal is then only returned at no more than the
+//                  lowest f such a child would have had. When a
+//                  node has generated every child its f is backed up,
+//                  and stays backed up from then on, so f values only
+//                  rise and the search cannot cycle at one f. The node
+//                  then leaves the open set, unless some children were
+//                  forgotten, in which case it walks its arcs again to
+//                  regenerate them (skipping nodes still held). Fails
+//                  once the best open f is infinite or the expansion
+//                  limit is reached.
+//  Arguments:      The start and destination and the vector the path
+//                  is written to.
+//  Return Value:   true if a path was found.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool MemoryBoundedSearch<NodeType, ArcType>::smaStar(NodeId start, NodeId dest, std::vector<NodeId>& path)
+{
+	m_expanded = 0;
+	m_gaveUp = false;
+	m_cutOff = infinity();
+	m_open.clear();
+	m_free.clear();
+	std::fill(m_sameHash.begin(), m_sameHash.end(), -1);
+	for (int i = (int)m_pool.size() - 1; i >= 0; i--)
+	{
+		m_free.push_back(i);
+	}
+	newNode(start, -1, 0, m_graph.estimate(start, dest));
+
+	while (!m_open.empty())
+	{
+		int best = m_open.begin()->index;
+		if (m_pool[best].f == infinity())
+		{
+			m_gaveUp = (m_cutOff != infinity());
+			return false;
+		}
+		if (m_pool[best].node == dest)
+		{
+			if (m_pool[best].costDist > m_cutOff)
+			{
+				m_gaveUp = true;
+				return false;
+			}
+			m_cost = m_pool[best].costDist;
+			for (int index = best; index >= 0; index = m_pool[index].parent)
+			{
+				path.push_back(m_pool[index].node);
+			}
+			return true;
+		}
+
+		// find the next arc to a node not already held at no more cost
+		// (which covers the node's ancestors and its own children).
+		SmaNode& parent = m_pool[best];
+		unsigned int endArc = m_graph.firstArc(parent.node + 1);
+		NodeId child = invalidNodeId();
+		ArcType dist = 0;
+		unsigned int arc = parent.nextArc;
+		for (; arc < endArc; arc++)
+		{
+			dist = parent.costDist + m_graph.arcWeight(arc);
+			if (!held(m_graph.arcTarget(arc), dist))
+			{
+				child = m_graph.arcTarget(arc);
+				break;
+			}
+		}
+
+		if (child != invalidNodeId())
+		{
+			if (m_expanded == m_maxExpanded)
+			{
+				m_gaveUp = true;
+				return false;
+			}
+			parent.nextArc = arc + 1;
+			m_expanded++;
+			ArcType f = std::max(parent.f, dist + m_graph.estimate(child, dest));
+			if (child != dest && parent.depth + 2 >= (int)m_pool.size())
+			{
+				m_cutOff = std::min(m_cutOff, f);
+				f = infinity();
+			}
+			if (m_free.empty() && !evict(best))
+			{
+				// nothing to drop: the child is forgotten straight away.
+				forget(best, f);
+			}
+			else
+			{
+				newNode(child, best, dist, f);
+			}
+		}
+		else
+		{
+			parent.nextArc = endArc;
+		}
+
+		SmaNode& node = m_pool[best];
+		if (node.nextArc == endArc)
+		{
+			// children dropped before this walk and not met again in it
+			// are held elsewhere at no more cost, so need not count.
+			node.forgotten = node.forgottenThisPass;
+			node.forgottenThisPass = infinity();
+			node.generated = true;
+			backUp(best);
+			if (node.forgotten == infinity())
+			{
+				if (node.firstChild >= 0)
+				{
+					close(best);
+				}
+				else
+				{
+					// a dead end: left open at f infinity so it is the
+					// first to go.
+					setF(best, infinity());
+				}
+			}
+			else
+			{
+				node.nextArc = m_graph.firstArc(node.node);
+			}
+		}
+	}
+	return false;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+
+// ----------------------------------------------------------------
+//  Name:           MpscQueue
+//  Description:    A lock free queue that any number of threads can
+//                  push onto and one thread pops from. Producers only
+//                  swap the head pointer and link the old head to the
+//                  new cell, so a push never waits on anything. The
+//                  consumer owns the tail and a stub cell that is
+//                  always at the front, so popping never touches the
+//                  head at all.
+//                  A pop can miss a cell whose producer has swapped
+//                  the head but not linked it yet; the cell shows up
+//                  on a later pop.
+// ----------------------------------------------------------------
+template<class T>
+class MpscQueue {
+private:
+	struct Cell {
+		std::atomic<Cell*> next;
+		T value;
+
+		Cell() : next(0) {}
+	};
+
+	std::atomic<Cell*> m_head;
+	Cell* m_tail;
+
+	MpscQueue(MpscQueue const &);
+	MpscQueue& operator=(MpscQueue const &);
+
+public:
+	MpscQueue()
+	{
+		Cell* pStub = new Cell;
+		m_head.store(pStub);
+		m_tail = pStub;
+	}
+
+	~MpscQueue()
+	{
+		while (m_tail != 0)
+		{
+			Cell* pNext = m_tail->next.load();
+			delete m_tail;
+			m_tail = pNext;
+		}
+	}
+
+	// Safe to call from any thread.
+	void push(T const & value)
+	{
+		Cell* pCell = new Cell;
+		pCell->value = value;
+		Cell* pPrev = m_head.exchange(pCell, std::memory_order_acq_rel);
+		pPrev->next.store(pCell, std::memory_order_release);
+	}
+
+	// Only the consuming thread may call this.
+	bool pop(T& value)
+	{
+		Cell* pNext = m_tail->next.load(std::memory_order_acquire);
+		if (pNext == 0)
+		{
+			return false;
+		}
+		// the popped cell becomes the new stub; swapping leaves it empty
+		// rather than holding a second copy of the value.
+		std::swap(value, pNext->value);
+		delete m_tail;
+		m_tail = pNext;
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef NODEORDER_H
+#define NODEORDER_H
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           NodeOrder
+//  Description:    A renumbering of the nodes of a graph, with the
+//                  map both ways so that callers holding the original
+//                  indices (from the order of the nodes file) can
+//                  still use them with the renumbered graph.
+// ----------------------------------------------------------------
+class NodeOrder {
+private:
+	std::vector<NodeId> m_newId;
+	std::vector<NodeId> m_oldId;
+
+public:
+	enum Method {
+		HILBERT,
+		BREADTH_FIRST,
+		REVERSE_CUTHILL_MCKEE
+	};
+
+	// Builds the order from the list of original ids in their new order.
+	explicit NodeOrder(std::vector<NodeId> const & oldIds) : m_newId(oldIds.size()), m_oldId(oldIds)
+	{
+		for (NodeId n = 0; n < (NodeId)oldIds.size(); n++)
+		{
+			m_newId[oldIds[n]] = n;
+		}
+	}
+
+	NodeId size() const
+	{
+		return (NodeId)m_oldId.size();
+	}
+
+	NodeId toNew(NodeId oldId) const
+	{
+		return m_newId[oldId];
+	}
+
+	NodeId toOld(NodeId newId) const
+	{
+		return m_oldId[newId];
+	}
+
+	// Turns a path of new ids back into original ids, in place.
+	void toOld(std::vector<NodeId>& path) const
+	{
+		for (size_t i = 0; i < path.size(); i++)
+		{
+			path[i] = m_oldId[path[i]];
+		}
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           hilbertIndex
+//  Description:    The distance along a Hilbert curve filling a
+//                  side x side grid (side a power of two) to a cell.
+//                  Cells close on the curve are close on the map.
+//  Arguments:      The grid side and the cell.
+//  Return Value:   The distance along the curve.
+// ----------------------------------------------------------------
+inline unsigned long long hilbertIndex(unsigned int side, unsigned int x, unsigned int y)
+{
+	unsigned long long d = 0;
+	for (unsigned int s = side / 2; s > 0; s /= 2)
+	{
+		unsigned int rx = (x & s) ? 1 : 0;
+		unsigned int ry = (y & s) ? 1 : 0;
+		d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant so the curve inside it lines up.
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = side - 1 - x;
+				y = side - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return d;
+}
+
+// ----------------------------------------------------------------
+//  Name:           undirectedNeighbours
+//  Description:    Every node's neighbours along arcs in either
+//                  direction, so the traversals below cover a node's
+//                  whole surroundings however the arcs point.
+//  Arguments:      The graph and the vector the lists go in.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void undirectedNeighbours(IndexedGraph<NodeType, ArcType> const & graph, std::vector<std::vector<NodeId> >& neighbours)
+{
+	neighbours.assign(graph.nodeCount(), std::vector<NodeId>());
+	for (NodeId from = 0; from < graph.nodeCount(); from++)
+	{
+		for (unsigned int arc = graph.firstArc(from); arc < graph.firstArc(from + 1); arc++)
+		{
+			neighbours[from].push_back(graph.arcTarget(arc));
+			neighbours[graph.arcTarget(arc)].push_back(from);
+		}
+	}
+	for (NodeId n = 0; n < graph.nodeCount(); n++)
+	{
+		std::sort(neighbours[n].begin(), neighbours[n].end());
+		neighbours[n].erase(std::unique(neighbours[n].begin(), neighbours[n].end()), neighbours[n].end());
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           orderNodes
+//  Description:    Works out a locality improving order:
+//                  HILBERT sorts the nodes along a Hilbert curve over
+//                  their positions, so nodes near each other on the
+//                  map get nearby ids.
+//                  BREADTH_FIRST numbers the nodes in the order a
+//                  breadth first traversal reaches them, so a node's
+//                  neighbours are numbered close to it.
+//                  REVERSE_CUTHILL_MCKEE is a breadth first traversal
+//                  from a low degree node that takes neighbours in
+//                  order of degree, reversed; it keeps the spread of
+//                  ids between neighbours (the bandwidth) small.
+//                  A traversal that runs out restarts from the next
+//                  unnumbered node (lowest degree first for Cuthill-
+//                  McKee), so every node gets an id.
+//  Arguments:      The graph and the method.
+//  Return Value:   The order.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+NodeOrder orderNodes(IndexedGraph<NodeType, ArcType> const & graph, NodeOrder::Method method)
+{
+	NodeId nodes = graph.nodeCount();
+	std::vector<NodeId> order;
+	order.reserve(nodes);
+
+	if (method == NodeOrder::HILBERT)
+	{
+		float minX = numeric_limits<float>::max(), minY = minX, maxX = -minX, maxY = -minX;
+		for (NodeId n = 0; n < nodes; n++)
+		{
+			minX = std::min(minX, graph.pos(n).x);
+			maxX = std::max(maxX, graph.pos(n).x);
+			minY = std::min(minY, graph.pos(n).y);
+			maxY = std::max(maxY, graph.pos(n).y);
+		}
+		unsigned int const side = 1u << 16;
+		float scale = (side - 1) / std::max(std::max(maxX - minX, maxY - minY), 1.0f);
+
+		std::vector<std::pair<unsigned long long, NodeId> > keys(nodes);
+		for (NodeId n = 0; n < nodes; n++)
+		{
+			unsigned int x = (unsigned int)((graph.pos(n).x - minX) * scale);
+			unsigned int y = (unsigned int)((graph.pos(n).y - minY) * scale);
+			keys[n] = std::make_pair(hilbertIndex(side, x, y), n);
+		}
+		std::sort(keys.begin(), keys.end());
+		for (NodeId n = 0; n < nodes; n++)
+		{
+			order.push_back(keys[n].second);
+		}
+		return NodeOrder(order);
+	}
+
+	std::vector<std::vector<NodeId> > neighbours;
+	undirectedNeighbours(graph, neighbours);
+	bool cuthillMcKee = method == NodeOrder::REVERSE_CUTHILL_MCKEE;
+
+	std::vector<NodeId> byDegree(nodes);
+	for (NodeId n = 0; n < nodes; n++)
+	{
+		byDegree[n] = n;
+	}
+	if (cuthillMcKee)
+	{
+		// starting each traversal from a low degree node puts it near
+		// the edge of its component.
+		std::stable_sort(byDegree.begin(), byDegree.end(), [&](NodeId a, NodeId b)
+		{
+			return neighbours[a].size() < neighbours[b].size();
+		});
+		for (NodeId n = 0; n < nodes; n++)
+		{
+			std::stable_sort(neighbours[n].begin(), neighbours[n].end(), [&](NodeId a, NodeId b)
+			{
+				return neighbours[a].size() < neighbours[b].size();
+			});
+		}
+	}
+
+	std::vector<char> numbered(nodes, false);
+	for (NodeId i = 0; i < nodes; i++)
+	{
+		NodeId root = byDegree[i];
+		if (numbered[root])
+		{
+			continue;
+		}
+		// the order vector doubles as the breadth first queue.
+		size_t head = order.size();
+		order.push_back(root);
+		numbered[root] = true;
+		for (; head < order.size(); head++)
+		{
+			std::vector<NodeId> const & next = neighbours[order[head]];
+			for (size_t j = 0; j < next.size(); j++)
+			{
+				if (!numbered[next[j]])
+				{
+					numbered[next[j]] = true;
+					order.push_back(next[j]);
+				}
+			}
+		}
+	}
+	if (cuthillMcKee)
+	{
+		std::reverse(order.begin(), order.end());
+	}
+	return NodeOrder(order);
+}
+
+// ----------------------------------------------------------------
+//  Name:           reorderGraph
+//  Description:    Copies a graph with its nodes renumbered. Data,
+//                  positions and arcs all move with their node, and
+//                  each node's arcs keep their order.
+//  Arguments:      The graph and the order.
+//  Return Value:   The renumbered graph.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+IndexedGraph<NodeType, ArcType> reorderGraph(IndexedGraph<NodeType, ArcType> const & graph, NodeOrder const & order)
+{
+	IndexedGraph<NodeType, ArcType> reordered(graph.nodeCount());
+	for (NodeId n = 0; n < graph.nodeCount(); n++)
+	{
+		NodeId old = order.toOld(n);
+		reordered.setNode(n, graph.data(old), graph.pos(old));
+		for (unsigned int arc = graph.firstArc(old); arc < graph.firstArc(old + 1); arc++)
+		{
+			reordered.addArc(n, order.toNew(graph.arcTarget(arc)), graph.arcWeight(arc));
+		}
+	}
+	reordered.finalise();
+	return reordered;
+}
+
+// ----------------------------------------------------------------
+//  Name:           OrderBenchmark
+//  Description:    How well an order keeps neighbours together. The
+//                  mean gap is the average distance in ids between
+//                  the two ends of an arc, and farArcs is the share of
+//                  arcs whose target's search state is more than one
+//                  64 byte cache line from the source's; both stand in
+//                  for cache misses, which cannot be counted portably.
+//                  queryTime is the wall clock time of the benchmark
+//                  queries in seconds.
+// ----------------------------------------------------------------
+struct OrderBenchmark {
+	double meanGap;
+	double farArcs;
+	double queryTime;
+};
+
+// ----------------------------------------------------------------
+//  Name:           benchmarkOrder
+//  Description:    Measures a graph's locality and times a fixed set
+//                  of A* queries on it. To compare orders, pass each
+//                  reordered graph the same queries mapped with
+//                  NodeOrder::toNew.
+//  Arguments:      The graph and the queries as start and goal pairs.
+//  Return Value:   The measurements.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+OrderBenchmark benchmarkOrder(IndexedGraph<NodeType, ArcType> const & graph, std::vector<std::pair<NodeId, NodeId> > const & queries)
+{
+	OrderBenchmark result = { 0, 0, 0 };
+	unsigned int const lineNodes = 64 / sizeof(ArcType);
+	for (NodeId from = 0; from < graph.nodeCount(); from++)
+	{
+		for (unsigned int arc = graph.firstArc(from); arc < graph.firstArc(from + 1); arc++)
+		{
+			NodeId gap = from > graph.arcTarget(arc) ? from - graph.arcTarget(arc) : graph.arcTarget(arc) - from;
+			result.meanGap += gap;
+			result.farArcs += (gap > lineNodes) ? 1 : 0;
+		}
+	}
+	if (graph.arcCount() > 0)
+	{
+		result.meanGap /= graph.arcCount();
+		result.farArcs /= graph.arcCount();
+	}
+
+	IndexedSearchSpace<ArcType> space;
+	std::vector<NodeId> path;
+	std::chrono::high_resolution_clock::time_point begin = std::chrono::high_resolution_clock::now();
+	for (size_t q = 0; q < queries.size(); q++)
+	{
+		path.clear();
+		graph.aStar(queries[q].first, queries[q].second, space, path);
+	}
+	result.queryTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+	return result;
+}
+
+#endif
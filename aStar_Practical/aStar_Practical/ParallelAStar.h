@@ -0,0 +1,422 @@
+#ifndef PARALLELASTAR_H
+#define PARALLELASTAR_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "IndexedGraph.h"
+#include "MpscQueue.h"
+
+// ----------------------------------------------------------------
+//  Name:           ParallelAStar
+//  Description:    Hash distributed A* (HDA*) for one long query.
+//                  Every node belongs to one worker thread, picked by
+//                  hashing its id, and only that worker ever keeps its
+//                  cost or puts it on an open list. A worker expanding
+//                  a node sends each child to the child's owner
+//                  through the owner's lock free queue, batched so one
+//                  queue push carries many children.
+//                  The best cost found to the goal so far is shared;
+//                  workers stop expanding once nothing on their open
+//                  list can beat it. The search is over when every
+//                  worker is idle and no batch is still in a queue,
+//                  at which point the shared cost is optimal.
+//                  The worker threads are started once and wait
+//                  between queries, and each clears its own search
+//                  state in O(1) at the start of a query, so a short
+//                  query costs little more than the search itself.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class ParallelAStar {
+private:
+	struct Message {
+		NodeId node;
+		NodeId prev;
+		ArcType costDist;
+	};
+	typedef std::vector<Message> Batch;
+
+	struct OpenEntry {
+		ArcType f;
+		ArcType costDist;
+		NodeId node;
+
+		bool operator>(OpenEntry const & other) const
+		{
+			return f > other.f;
+		}
+	};
+
+// ----------------------------------------------------------------
+//  Description:    What each worker owns. Its search space covers
+//                  only its own nodes, indexed by each node's rank
+//                  among them (m_rank), so the workers' spaces add up
+//                  to one graph's worth and no two threads ever write
+//                  the same cache line.
+// ----------------------------------------------------------------
+	struct Worker {
+		MpscQueue<Batch> inbox;
+		IndexedSearchSpace<ArcType> space;
+		NodeId owned;
+		std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > open;
+		std::vector<Batch> outbox;
+		int expanded;
+	};
+
+	IndexedGraph<NodeType, ArcType> const & m_graph;
+	int m_threads;
+	std::vector<std::unique_ptr<Worker> > m_workers;
+	std::vector<NodeId> m_rank;
+
+// ----------------------------------------------------------------
+//  Description:    The threads of workers 1 and up (the caller of
+//                  search() is worker 0). Each runs a query when
+//                  m_query goes up and counts itself in m_finished
+//                  when it is over.
+// ----------------------------------------------------------------
+	std::vector<std::thread> m_pool;
+	std::mutex m_poolMutex;
+	std::condition_variable m_start;
+	std::condition_variable m_finish;
+	unsigned int m_query;
+	int m_finished;
+	bool m_stopping;
+
+	NodeId m_dest;
+	std::atomic<ArcType> m_best;
+
+// ----------------------------------------------------------------
+//  Description:    Busy workers plus batches sent but not yet taken
+//                  in. A batch is counted before it is pushed and a
+//                  worker counts itself busy before giving the count
+//                  of a batch up, so this cannot reach zero while
+//                  anything is left to do, and once it is zero it
+//                  stays there.
+// ----------------------------------------------------------------
+	std::atomic<int> m_active;
+	std::atomic<bool> m_done;
+
+	ParallelAStar(ParallelAStar const &);
+	ParallelAStar& operator=(ParallelAStar const &);
+
+	static ArcType unreachable()
+	{
+		return numeric_limits<ArcType>::max();
+	}
+
+	// The worker a node belongs to. Multiplying by a large odd number
+	// scatters neighbouring ids, and the high bits pick the worker.
+	int owner(NodeId node) const
+	{
+		unsigned int hash = (unsigned int)node * 2654435761u;
+		return (int)(((unsigned long long)hash * m_threads) >> 32);
+	}
+
+	void receive(Worker& worker, Message const & message);
+	void flush(Worker& worker);
+	void run(int index);
+	void serve(int index);
+
+public:
+	// Number of children a worker collects for one owner before it
+	// sends them.
+	static size_t batchSize()
+	{
+		return 64;
+	}
+
+	ParallelAStar(IndexedGraph<NodeType, ArcType> const & graph, int threads);
+	~ParallelAStar();
+
+	bool search(NodeId start, NodeId dest, std::vector<NodeId>& path);
+
+	// The cost of the path found by the last search.
+	ArcType cost() const
+	{
+		return m_best.load();
+	}
+
+	// Nodes expanded by each worker in the last search, to see how
+	// evenly the hashing shared the work out.
+	int expanded(int worker) const
+	{
+		return m_workers[worker]->expanded;
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           ParallelAStar
+//  Description:    Shares the nodes out between the workers, ranking
+//                  each among its owner's nodes, and starts the
+//                  worker threads, which wait for the first query.
+//  Arguments:      The graph and the number of workers, counting the
+//                  thread that calls search().
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+ParallelAStar<NodeType, ArcType>::ParallelAStar(IndexedGraph<NodeType, ArcType> const & graph, int threads)
+	: m_graph(graph), m_threads(std::max(threads, 1)), m_query(0), m_finished(0), m_stopping(false),
+	m_dest(invalidNodeId()), m_active(0), m_done(false)
+{
+	m_best.store(unreachable());
+	for (int i = 0; i < m_threads; i++)
+	{
+		m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+		m_workers[i]->owned = 0;
+		m_workers[i]->expanded = 0;
+	}
+	m_rank.resize(graph.nodeCount());
+	for (NodeId node = 0; node < graph.nodeCount(); node++)
+	{
+		m_rank[node] = m_workers[owner(node)]->owned++;
+	}
+	for (int i = 1; i < m_threads; i++)
+	{
+		m_pool.push_back(std::thread(&ParallelAStar::serve, this, i));
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           ~ParallelAStar
+//  Description:    Wakes the worker threads to stop and joins them.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+ParallelAStar<NodeType, ArcType>::~ParallelAStar()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_poolMutex);
+		m_stopping = true;
+	}
+	m_start.notify_all();
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		m_pool[i].join();
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           receive
+//  Description:    Takes in a child for one of the worker's own nodes.
+//                  The goal is never expanded; reaching it only
+//                  lowers the best cost.
+//  Arguments:      The owning worker and the child.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void ParallelAStar<NodeType, ArcType>::receive(Worker& worker, Message const & message)
+{
+	NodeId rank = m_rank[message.node];
+	if (message.costDist >= worker.space.costDist(rank))
+	{
+		return;
+	}
+	worker.space.set(rank, message.costDist, message.prev);
+
+	if (message.node == m_dest)
+	{
+		ArcType best = m_best.load();
+		while (message.costDist < best && !m_best.compare_exchange_weak(best, message.costDist))
+		{
+		}
+		return;
+	}
+	OpenEntry entry = { message.costDist + m_graph.estimate(message.node, m_dest), message.costDist, message.node };
+	worker.open.push(entry);
+}
+
+// ----------------------------------------------------------------
+//  Name:           flush
+//  Description:    Sends every non empty batch in the worker's outbox.
+//  Arguments:      The sending worker.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void ParallelAStar<NodeType, ArcType>::flush(Worker& worker)
+{
+	for (int to = 0; to < m_threads; to++)
+	{
+		if (!worker.outbox[to].empty())
+		{
+			m_active++;
+			m_workers[to]->inbox.push(worker.outbox[to]);
+			worker.outbox[to].clear();
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           run
+//  Description:    One worker's part in a query. It clears its own
+//                  state, then loops: take in whatever has arrived,
+//                  expand a few of its own nodes, send the children
+//                  on, and go idle once nothing it holds can beat the
+//                  best cost. Batches sent to it before it started
+//                  wait in its inbox until the state is clear.
+//  Arguments:      The worker's index.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void ParallelAStar<NodeType, ArcType>::run(int index)
+{
+	Worker& worker = *m_workers[index];
+	worker.space.reset(worker.owned);
+	worker.outbox.assign(m_threads, Batch());
+	worker.expanded = 0;
+	bool busy = false;
+	Batch batch;
+
+	while (!m_done.load())
+	{
+		while (worker.inbox.pop(batch))
+		{
+			if (!busy)
+			{
+				m_active++;
+				busy = true;
+			}
+			for (size_t i = 0; i < batch.size(); i++)
+			{
+				receive(worker, batch[i]);
+			}
+			batch.clear();
+			m_active--;
+		}
+		if (!busy)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		for (int step = 0; step < (int)batchSize() && !worker.open.empty(); step++)
+		{
+			OpenEntry top = worker.open.top();
+			worker.open.pop();
+			if (top.costDist != worker.space.costDist(m_rank[top.node]))
+			{
+				continue;
+			}
+			if (top.f >= m_best.load())
+			{
+				// everything else on the list is at least as far off.
+				worker.open = std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> >();
+				break;
+			}
+			worker.expanded++;
+
+			for (unsigned int arc = m_graph.firstArc(top.node); arc < m_graph.firstArc(top.node + 1); arc++)
+			{
+				Message child = { m_graph.arcTarget(arc), top.node, top.costDist + m_graph.arcWeight(arc) };
+				int to = owner(child.node);
+				if (to == index)
+				{
+					receive(worker, child);
+				}
+				else
+				{
+					worker.outbox[to].push_back(child);
+				}
+			}
+		}
+		flush(worker);
+
+		if (worker.open.empty())
+		{
+			busy = false;
+			if (--m_active == 0)
+			{
+				m_done.store(true);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           serve
+//  Description:    A pool thread: runs its worker for each query until
+//                  the ParallelAStar is destroyed.
+//  Arguments:      The worker's index.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void ParallelAStar<NodeType, ArcType>::serve(int index)
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_poolMutex);
+			while (m_query == seen && !m_stopping)
+			{
+				m_start.wait(lock);
+			}
+			if (m_stopping)
+			{
+				return;
+			}
+			seen = m_query;
+		}
+		run(index);
+		{
+			std::lock_guard<std::mutex> lock(m_poolMutex);
+			m_finished++;
+		}
+		m_finish.notify_one();
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           search
+//  Description:    Runs one query on all the workers, the calling
+//                  thread being one of them.
+//  Arguments:      The start and goal, and the vector the path is
+//                  written to, goal first like IndexedGraph::aStar.
+//  Return Value:   true if the goal can be reached.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+bool ParallelAStar<NodeType, ArcType>::search(NodeId start, NodeId dest, std::vector<NodeId>& path)
+{
+	m_dest = dest;
+	m_best.store(unreachable());
+	m_done.store(false);
+
+	Message first = { start, invalidNodeId(), 0 };
+	m_active.store(1);
+	m_workers[owner(start)]->inbox.push(Batch(1, first));
+
+	{
+		std::lock_guard<std::mutex> lock(m_poolMutex);
+		m_finished = 0;
+		m_query++;
+	}
+	m_start.notify_all();
+	run(0);
+	{
+		std::unique_lock<std::mutex> lock(m_poolMutex);
+		while (m_finished < (int)m_pool.size())
+		{
+			m_finish.wait(lock);
+		}
+	}
+
+	if (m_best.load() == unreachable())
+	{
+		return false;
+	}
+	for (NodeId node = dest; node != invalidNodeId(); node = m_workers[owner(node)]->space.prev(m_rank[node]))
+	{
+		path.push_back(node);
+	}
+	return true;
+}
+
+#endif
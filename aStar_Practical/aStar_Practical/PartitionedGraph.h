@@ -0,0 +1,773 @@
+#ifndef PARTITIONEDGRAPH_H
+#define PARTITIONEDGRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IndexedGraph.h"
+#include "MappedFile.h"
+
+// ----------------------------------------------------------------
+//  Description:    The on disk layout. Every file starts with one of
+//                  these headers and the arrays follow it, each padded
+//                  to 8 bytes so they can be read straight out of the
+//                  mapping. Nodes are renumbered so each partition is
+//                  one contiguous range of ids. scale is the graph's
+//                  heuristicScale() when it was written; files from
+//                  before it was kept hold 0, which searches without
+//                  an estimate.
+//                  <prefix>.index    header, the first id of each
+//                                    partition (plus one past the
+//                                    end), then the new id of every
+//                                    original id and the reverse.
+//                  <prefix>.overlay  header, then for each partition
+//                                    its centre and first link, then
+//                                    the links: the partitions its
+//                                    boundary arcs lead into.
+//                  <prefix>.<n>.part header, then positions, arc
+//                                    offsets, arc targets (global
+//                                    ids) and arc weights.
+// ----------------------------------------------------------------
+struct PartitionedFileHeader {
+	unsigned int magic;
+	unsigned int nodes;
+	unsigned int arcs;
+	unsigned int partitions;
+	NodeId firstNode;
+	float scale;
+};
+
+struct PartitionCentre {
+	float x;
+	float y;
+	unsigned int firstLink;
+	unsigned int pad;
+};
+
+inline unsigned int partitionedMagic()
+{
+	return 0x50415254u;
+}
+
+inline size_t paddedSize(size_t bytes)
+{
+	return (bytes + 7) & ~(size_t)7;
+}
+
+// Steps an offset past an array of count items as writePadded wrote
+// it, failing if the array would run past the end of the file.
+inline bool skipPadded(size_t& offset, size_t count, size_t itemBytes, size_t fileBytes)
+{
+	if (offset > fileBytes || count > (fileBytes - offset) / itemBytes)
+	{
+		return false;
+	}
+	offset += paddedSize(count * itemBytes);
+	return offset <= fileBytes;
+}
+
+inline std::string partitionFileName(std::string const & prefix, unsigned int partition)
+{
+	std::ostringstream name;
+	name << prefix << "." << partition << ".part";
+	return name.str();
+}
+
+template<class T>
+void writePadded(std::ofstream& file, T const * pData, size_t count)
+{
+	static char const zeros[8] = { 0 };
+	size_t bytes = count * sizeof(T);
+	if (bytes > 0)
+	{
+		file.write((char const *)pData, bytes);
+	}
+	file.write(zeros, paddedSize(bytes) - bytes);
+}
+
+// ----------------------------------------------------------------
+//  Name:           bisectNodes
+//  Description:    Recursive coordinate bisection: splits the nodes
+//                  at the median of the longer side of their bounding
+//                  box until no part holds more than the limit. The
+//                  parts come out with nearly equal node counts and
+//                  compact shapes, so few arcs cross between them.
+//  Arguments:      The graph, the range of node ids to split (which
+//                  is reordered), the largest partition, the vector
+//                  the end of each partition is written to and the
+//                  position of the range in the whole order.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+void bisectNodes(IndexedGraph<NodeType, ArcType> const & graph, std::vector<NodeId>::iterator begin,
+	std::vector<NodeId>::iterator end, NodeId maxNodes, std::vector<NodeId>& ends, NodeId offset)
+{
+	NodeId count = (NodeId)(end - begin);
+	if (count <= maxNodes)
+	{
+		ends.push_back(offset + count);
+		return;
+	}
+
+	float minX = numeric_limits<float>::max(), minY = minX, maxX = -minX, maxY = -minX;
+	for (std::vector<NodeId>::iterator it = begin; it != end; ++it)
+	{
+		GraphPosition pos = graph.pos(*it);
+		minX = std::min(minX, pos.x);
+		maxX = std::max(maxX, pos.x);
+		minY = std::min(minY, pos.y);
+		maxY = std::max(maxY, pos.y);
+	}
+	bool alongX = (maxX - minX) >= (maxY - minY);
+	std::vector<NodeId>::iterator middle = begin + count / 2;
+	std::nth_element(begin, middle, end, [&](NodeId a, NodeId b)
+	{
+		return alongX ? graph.pos(a).x < graph.pos(b).x : graph.pos(a).y < graph.pos(b).y;
+	});
+	bisectNodes(graph, begin, middle, maxNodes, ends, offset);
+	bisectNodes(graph, middle, end, maxNodes, ends, offset + count / 2);
+}
+
+// ----------------------------------------------------------------
+//  Name:           writePartitionedGraph
+//  Description:    Splits a graph into partitions and writes it out
+//                  in the layout PartitionedGraph reads.
+//  Arguments:      The graph, the file name prefix and the largest
+//                  number of nodes in one partition.
+//  Return Value:   The number of partitions, or 0 if a file could
+//                  not be written.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+unsigned int writePartitionedGraph(IndexedGraph<NodeType, ArcType> const & graph, std::string const & prefix, NodeId maxNodes)
+{
+	NodeId nodes = graph.nodeCount();
+	std::vector<NodeId> oldId(nodes);
+	for (NodeId n = 0; n < nodes; n++)
+	{
+		oldId[n] = n;
+	}
+	std::vector<NodeId> firstNode(1, 0);
+	if (nodes > 0)
+	{
+		bisectNodes(graph, oldId.begin(), oldId.end(), std::max(maxNodes, (NodeId)1), firstNode, 0);
+	}
+	unsigned int partitions = (unsigned int)firstNode.size() - 1;
+
+	std::vector<NodeId> newId(nodes);
+	std::vector<unsigned int> partitionOf(nodes);
+	for (unsigned int p = 0; p < partitions; p++)
+	{
+		for (NodeId n = firstNode[p]; n < firstNode[p + 1]; n++)
+		{
+			newId[oldId[n]] = n;
+			partitionOf[n] = p;
+		}
+	}
+
+	std::vector<PartitionCentre> centres(partitions + 1);
+	std::vector<unsigned int> links;
+	for (unsigned int p = 0; p < partitions; p++)
+	{
+		NodeId count = firstNode[p + 1] - firstNode[p];
+		std::vector<GraphPosition> pos(count);
+		std::vector<unsigned int> firstArc(1, 0);
+		std::vector<NodeId> targets;
+		std::vector<ArcType> weights;
+		std::vector<unsigned int> linked;
+		float x = 0, y = 0;
+
+		for (NodeId n = firstNode[p]; n < firstNode[p + 1]; n++)
+		{
+			NodeId old = oldId[n];
+			pos[n - firstNode[p]] = graph.pos(old);
+			x += graph.pos(old).x;
+			y += graph.pos(old).y;
+			for (unsigned int arc = graph.firstArc(old); arc < graph.firstArc(old + 1); arc++)
+			{
+				NodeId target = newId[graph.arcTarget(arc)];
+				targets.push_back(target);
+				weights.push_back(graph.arcWeight(arc));
+				if (partitionOf[target] != p)
+				{
+					linked.push_back(partitionOf[target]);
+				}
+			}
+			firstArc.push_back((unsigned int)targets.size());
+		}
+
+		std::sort(linked.begin(), linked.end());
+		linked.erase(std::unique(linked.begin(), linked.end()), linked.end());
+		PartitionCentre centre = { x / count, y / count, (unsigned int)links.size(), 0 };
+		centres[p] = centre;
+		links.insert(links.end(), linked.begin(), linked.end());
+
+		std::ofstream file(partitionFileName(prefix, p).c_str(), std::ios::binary);
+		PartitionedFileHeader header = { partitionedMagic(), count, (unsigned int)targets.size(), 1, firstNode[p], graph.heuristicScale() };
+		writePadded(file, &header, 1);
+		writePadded(file, pos.empty() ? 0 : &pos[0], pos.size());
+		writePadded(file, &firstArc[0], firstArc.size());
+		writePadded(file, targets.empty() ? 0 : &targets[0], targets.size());
+		writePadded(file, weights.empty() ? 0 : &weights[0], weights.size());
+		if (!file)
+		{
+			return 0;
+		}
+	}
+	PartitionCentre end = { 0, 0, (unsigned int)links.size(), 0 };
+	centres[partitions] = end;
+
+	std::ofstream index((prefix + ".index").c_str(), std::ios::binary);
+	PartitionedFileHeader indexHeader = { partitionedMagic(), nodes, 0, partitions, 0, graph.heuristicScale() };
+	writePadded(index, &indexHeader, 1);
+	writePadded(index, &firstNode[0], firstNode.size());
+	writePadded(index, newId.empty() ? 0 : &newId[0], newId.size());
+	writePadded(index, oldId.empty() ? 0 : &oldId[0], oldId.size());
+
+	std::ofstream overlay((prefix + ".overlay").c_str(), std::ios::binary);
+	PartitionedFileHeader overlayHeader = { partitionedMagic(), nodes, (unsigned int)links.size(), partitions, 0, graph.heuristicScale() };
+	writePadded(overlay, &overlayHeader, 1);
+	writePadded(overlay, &centres[0], centres.size());
+	writePadded(overlay, links.empty() ? 0 : &links[0], links.size());
+	return (index && overlay) ? partitions : 0;
+}
+
+// ----------------------------------------------------------------
+//  Name:           PartitionedGraph
+//  Description:    A graph kept on disk as separately mapped
+//                  partitions, for maps too big to hold in memory.
+//                  Only the index and the overlay (one entry per
+//                  partition and one per pair of neighbouring
+//                  partitions) stay loaded. A search maps partitions
+//                  as it reaches them, through a cache that holds a
+//                  fixed number of them and unmaps the least recently
+//                  used. Search state is kept per partition too, and
+//                  only for partitions the search touched.
+//                  Before a search the overlay is searched backwards
+//                  from the goal's partition, which gives the next
+//                  partition towards the goal from anywhere. Whenever
+//                  the search maps a new partition it also asks for
+//                  the next few along that route to be read ahead.
+// ----------------------------------------------------------------
+template<class ArcType>
+class PartitionedGraph {
+private:
+	struct Partition {
+		unsigned int id;
+		MappedFile file;
+		NodeId firstNode;
+		NodeId nodes;
+		GraphPosition const * pPos;
+		unsigned int const * pFirstArc;
+		NodeId const * pTarget;
+		ArcType const * pWeight;
+	};
+	typedef std::list<std::shared_ptr<Partition> > PartitionList;
+
+	struct SearchState {
+		std::vector<ArcType> costDist;
+		std::vector<NodeId> prev;
+	};
+
+	// The per partition search state seen as one space, for
+	// BestFirstSearch.
+	struct PartitionSpace {
+		PartitionedGraph& graph;
+
+		ArcType costDist(NodeId node)
+		{
+			unsigned int id = graph.partitionOf(node);
+			return graph.state(id).costDist[node - graph.m_pFirstNode[id]];
+		}
+
+		void set(NodeId node, ArcType costDist, NodeId prev)
+		{
+			unsigned int id = graph.partitionOf(node);
+			SearchState& nodeState = graph.state(id);
+			nodeState.costDist[node - graph.m_pFirstNode[id]] = costDist;
+			nodeState.prev[node - graph.m_pFirstNode[id]] = prev;
+		}
+	};
+
+	// Follows a node's arcs, mapping its partition first. The arcs
+	// are copied out, as mapping a child's partition for the
+	// estimate may unmap the parent's. failed is set when a
+	// partition cannot be mapped, which gives the search up.
+	struct PartitionArcs {
+		PartitionedGraph& graph;
+		std::vector<std::pair<NodeId, ArcType> >& arcs;
+		bool& failed;
+
+		template<class Relax>
+		bool operator()(NodeId node, Relax& relax) const
+		{
+			unsigned int id = graph.partitionOf(node);
+			NodeId local = node - graph.m_pFirstNode[id];
+			Partition* pParent = graph.partition(id);
+			if (pParent == 0)
+			{
+				failed = true;
+				return false;
+			}
+			arcs.clear();
+			for (unsigned int arc = pParent->pFirstArc[local]; arc < pParent->pFirstArc[local + 1]; arc++)
+			{
+				arcs.push_back(std::make_pair(pParent->pTarget[arc], pParent->pWeight[arc]));
+			}
+			for (size_t i = 0; i < arcs.size() && !failed; i++)
+			{
+				relax(arcs[i].first, arcs[i].second);
+			}
+			return !failed;
+		}
+	};
+
+	std::string m_prefix;
+	MappedFile m_index;
+	MappedFile m_overlay;
+	PartitionedFileHeader m_header;
+	NodeId const * m_pFirstNode;
+	NodeId const * m_pNewId;
+	NodeId const * m_pOldId;
+	PartitionCentre const * m_pCentres;
+	unsigned int const * m_pLinks;
+
+// ----------------------------------------------------------------
+//  Description:    Mapped partitions, most recently used first, and
+//                  where each one is in the list (end() if it is not
+//                  mapped).
+// ----------------------------------------------------------------
+	PartitionList m_cache;
+	std::vector<typename PartitionList::iterator> m_cached;
+	size_t m_capacity;
+	int m_readahead;
+	int m_loads;
+
+	std::vector<std::unique_ptr<SearchState> > m_state;
+	std::vector<unsigned int> m_touched;
+	std::vector<unsigned int> m_towardGoal;
+
+	PartitionedGraph(PartitionedGraph const &);
+	PartitionedGraph& operator=(PartitionedGraph const &);
+
+	Partition* partition(unsigned int id);
+	Partition* load(unsigned int id);
+	void routeOverlay(unsigned int goal);
+	void readAhead(unsigned int from);
+
+	SearchState& state(unsigned int id)
+	{
+		if (!m_state[id])
+		{
+			NodeId nodes = m_pFirstNode[id + 1] - m_pFirstNode[id];
+			m_state[id].reset(new SearchState);
+			m_state[id]->costDist.assign(nodes, numeric_limits<ArcType>::max());
+			m_state[id]->prev.assign(nodes, invalidNodeId());
+			m_touched.push_back(id);
+		}
+		return *m_state[id];
+	}
+
+	float estimate(GraphPosition from, GraphPosition to) const
+	{
+		float x = to.x - from.x;
+		float y = to.y - from.y;
+		return sqrt(x * x + y * y);
+	}
+
+public:
+	PartitionedGraph() : m_pFirstNode(0), m_pNewId(0), m_pOldId(0), m_pCentres(0), m_pLinks(0),
+		m_capacity(16), m_readahead(2), m_loads(0)
+	{
+		m_header.nodes = 0;
+		m_header.partitions = 0;
+		m_header.scale = 0;
+	}
+
+	bool open(std::string const & prefix, size_t capacity);
+
+	NodeId nodeCount() const
+	{
+		return m_header.nodes;
+	}
+
+	unsigned int partitionCount() const
+	{
+		return m_header.partitions;
+	}
+
+	// The partition holding a node (ids here are the renumbered ones).
+	unsigned int partitionOf(NodeId node) const
+	{
+		return (unsigned int)(std::upper_bound(m_pFirstNode, m_pFirstNode + m_header.partitions + 1, node) - m_pFirstNode) - 1;
+	}
+
+	// How many partitions past the current one to read ahead.
+	void setReadahead(int partitions)
+	{
+		m_readahead = partitions;
+	}
+
+	// Number of times a partition has been mapped, to size the cache.
+	int loads() const
+	{
+		return m_loads;
+	}
+
+	size_t cached() const
+	{
+		return m_cache.size();
+	}
+
+	bool aStar(NodeId start, NodeId dest, std::vector<NodeId>& path);
+};
+
+// ----------------------------------------------------------------
+//  Name:           open
+//  Description:    Maps the index and overlay written by
+//                  writePartitionedGraph.
+//  Arguments:      The file name prefix and the most partitions to
+//                  keep mapped at once (at least two).
+//  Return Value:   false if the files are missing or not valid: bad
+//                  magic, headers that disagree, arrays that run past
+//                  the end of a file, or partition and link ranges out
+//                  of order. The graph is then empty.
+// ----------------------------------------------------------------
+template<class ArcType>
+bool PartitionedGraph<ArcType>::open(std::string const & prefix, size_t capacity)
+{
+	m_cache.clear();
+	m_cached.clear();
+	m_state.clear();
+	m_touched.clear();
+	m_header.nodes = 0;
+	m_header.partitions = 0;
+	m_prefix = prefix;
+	m_capacity = std::max(capacity, (size_t)2);
+	if (!m_index.open(prefix + ".index") || !m_overlay.open(prefix + ".overlay"))
+	{
+		return false;
+	}
+
+	// every array must lie inside its file, and the two headers agree.
+	size_t headerBytes = paddedSize(sizeof(PartitionedFileHeader));
+	if (m_index.size() < headerBytes || m_overlay.size() < headerBytes)
+	{
+		return false;
+	}
+	PartitionedFileHeader header = *(PartitionedFileHeader const *)m_index.data();
+	PartitionedFileHeader const & overlayHeader = *(PartitionedFileHeader const *)m_overlay.data();
+	if (header.magic != partitionedMagic() || overlayHeader.magic != partitionedMagic() ||
+		overlayHeader.nodes != header.nodes || overlayHeader.partitions != header.partitions)
+	{
+		return false;
+	}
+	size_t offset = headerBytes;
+	m_pFirstNode = (NodeId const *)(m_index.data() + offset);
+	if (!skipPadded(offset, (size_t)header.partitions + 1, sizeof(NodeId), m_index.size()))
+	{
+		return false;
+	}
+	m_pNewId = (NodeId const *)(m_index.data() + offset);
+	if (!skipPadded(offset, header.nodes, sizeof(NodeId), m_index.size()))
+	{
+		return false;
+	}
+	m_pOldId = (NodeId const *)(m_index.data() + offset);
+	if (!skipPadded(offset, header.nodes, sizeof(NodeId), m_index.size()))
+	{
+		return false;
+	}
+
+	offset = headerBytes;
+	m_pCentres = (PartitionCentre const *)(m_overlay.data() + offset);
+	if (!skipPadded(offset, (size_t)header.partitions + 1, sizeof(PartitionCentre), m_overlay.size()))
+	{
+		return false;
+	}
+	m_pLinks = (unsigned int const *)(m_overlay.data() + offset);
+	if (!skipPadded(offset, overlayHeader.arcs, sizeof(unsigned int), m_overlay.size()))
+	{
+		return false;
+	}
+
+	// the partition ranges and link ranges are indexed without checks
+	// from then on, so they must run in order and end where they should.
+	if (m_pFirstNode[0] != 0 || m_pFirstNode[header.partitions] != header.nodes ||
+		m_pCentres[0].firstLink != 0 || m_pCentres[header.partitions].firstLink != overlayHeader.arcs)
+	{
+		return false;
+	}
+	for (unsigned int p = 0; p < header.partitions; p++)
+	{
+		if (m_pFirstNode[p] > m_pFirstNode[p + 1] || m_pCentres[p].firstLink > m_pCentres[p + 1].firstLink)
+		{
+			return false;
+		}
+	}
+	for (unsigned int l = 0; l < overlayHeader.arcs; l++)
+	{
+		if (m_pLinks[l] >= header.partitions)
+		{
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_cached.assign(m_header.partitions, m_cache.end());
+	m_state.resize(m_header.partitions);
+	return true;
+}
+
+// ----------------------------------------------------------------
+//  Name:           load
+//  Description:    Maps a partition if it is not mapped already,
+//                  unmapping the least recently used one if the
+//                  cache is full, and moves it to the front.
+//  Arguments:      The partition.
+//  Return Value:   The partition, or 0 if its file cannot be read,
+//                  does not match the index or holds arcs that do
+//                  not fit the graph.
+// ----------------------------------------------------------------
+template<class ArcType>
+typename PartitionedGraph<ArcType>::Partition* PartitionedGraph<ArcType>::load(unsigned int id)
+{
+	if (m_cached[id] != m_cache.end())
+	{
+		m_cache.splice(m_cache.begin(), m_cache, m_cached[id]);
+		return m_cache.front().get();
+	}
+
+	std::shared_ptr<Partition> pPartition(new Partition);
+	if (!pPartition->file.open(partitionFileName(m_prefix, id)))
+	{
+		return 0;
+	}
+	// the file must be the partition the index says, with every array
+	// inside it.
+	char const * pData = pPartition->file.data();
+	size_t bytes = pPartition->file.size();
+	size_t offset = paddedSize(sizeof(PartitionedFileHeader));
+	if (bytes < offset)
+	{
+		return 0;
+	}
+	PartitionedFileHeader const & header = *(PartitionedFileHeader const *)pData;
+	if (header.magic != partitionedMagic() || header.firstNode != m_pFirstNode[id] ||
+		header.nodes != m_pFirstNode[id + 1] - m_pFirstNode[id])
+	{
+		return 0;
+	}
+	pPartition->id = id;
+	pPartition->nodes = header.nodes;
+	pPartition->firstNode = header.firstNode;
+	pPartition->pPos = (GraphPosition const *)(pData + offset);
+	bool fits = skipPadded(offset, header.nodes, sizeof(GraphPosition), bytes);
+	pPartition->pFirstArc = (unsigned int const *)(pData + offset);
+	fits = fits && skipPadded(offset, (size_t)header.nodes + 1, sizeof(unsigned int), bytes);
+	pPartition->pTarget = (NodeId const *)(pData + offset);
+	fits = fits && skipPadded(offset, header.arcs, sizeof(NodeId), bytes);
+	pPartition->pWeight = (ArcType const *)(pData + offset);
+	fits = fits && skipPadded(offset, header.arcs, sizeof(ArcType), bytes);
+	if (!fits || pPartition->pFirstArc[header.nodes] != header.arcs)
+	{
+		return 0;
+	}
+	// every node's arcs must lie inside the arc arrays, and every arc
+	// must lead to a node of the graph, or partitionOf() would be
+	// asked about a node no partition holds.
+	for (NodeId node = 0; node < header.nodes; node++)
+	{
+		if (pPartition->pFirstArc[node] > pPartition->pFirstArc[node + 1])
+		{
+			return 0;
+		}
+	}
+	for (unsigned int arc = 0; arc < header.arcs; arc++)
+	{
+		if (pPartition->pTarget[arc] >= m_header.nodes)
+		{
+			return 0;
+		}
+	}
+
+	if (m_cache.size() >= m_capacity)
+	{
+		m_cached[m_cache.back()->id] = m_cache.end();
+		m_cache.pop_back();
+	}
+	m_cache.push_front(pPartition);
+	m_cached[id] = m_cache.begin();
+	m_loads++;
+	return pPartition.get();
+}
+
+// ----------------------------------------------------------------
+//  Name:           partition
+//  Description:    Maps a partition the search needs and reads ahead
+//                  along the route to the goal whenever it was not
+//                  already mapped.
+//  Arguments:      The partition.
+//  Return Value:   The partition, or 0 if its file cannot be read.
+// ----------------------------------------------------------------
+template<class ArcType>
+typename PartitionedGraph<ArcType>::Partition* PartitionedGraph<ArcType>::partition(unsigned int id)
+{
+	bool mapped = m_cached[id] != m_cache.end();
+	Partition* pPartition = load(id);
+	if (pPartition != 0 && !mapped)
+	{
+		readAhead(id);
+		// the read ahead went in front; the partition in use goes back on top.
+		load(id);
+	}
+	return pPartition;
+}
+
+// ----------------------------------------------------------------
+//  Name:           routeOverlay
+//  Description:    Uniform cost search over the overlay from the
+//                  goal's partition, with the distance between
+//                  partition centres as the cost of a link, to find
+//                  the next partition towards the goal from each.
+//  Arguments:      The goal's partition.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+template<class ArcType>
+void PartitionedGraph<ArcType>::routeOverlay(unsigned int goal)
+{
+	typedef std::pair<float, unsigned int> Entry;
+	unsigned int partitions = m_header.partitions;
+	std::vector<float> cost(partitions, numeric_limits<float>::max());
+	m_towardGoal.assign(partitions, partitions);
+
+	// links are stored going out, so walk them backwards once.
+	std::vector<std::vector<unsigned int> > in(partitions);
+	for (unsigned int p = 0; p < partitions; p++)
+	{
+		for (unsigned int l = m_pCentres[p].firstLink; l < m_pCentres[p + 1].firstLink; l++)
+		{
+			in[m_pLinks[l]].push_back(p);
+		}
+	}
+
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	cost[goal] = 0;
+	open.push(Entry(0.0f, goal));
+	while (!open.empty())
+	{
+		Entry top = open.top();
+		open.pop();
+		if (top.first != cost[top.second])
+		{
+			continue;
+		}
+		GraphPosition centre(m_pCentres[top.second].x, m_pCentres[top.second].y);
+		for (size_t i = 0; i < in[top.second].size(); i++)
+		{
+			unsigned int from = in[top.second][i];
+			float dist = top.first + estimate(GraphPosition(m_pCentres[from].x, m_pCentres[from].y), centre);
+			if (dist < cost[from])
+			{
+				cost[from] = dist;
+				m_towardGoal[from] = top.second;
+				open.push(Entry(dist, from));
+			}
+		}
+	}
+}
+
+template<class ArcType>
+void PartitionedGraph<ArcType>::readAhead(unsigned int from)
+{
+	unsigned int next = m_towardGoal[from];
+	// never read ahead more than the cache can hold next to the current one.
+	for (int i = 0; i < m_readahead && i + 1 < (int)m_capacity && next < m_header.partitions; i++)
+	{
+		if (m_cached[next] == m_cache.end())
+		{
+			Partition* pPartition = load(next);
+			if (pPartition != 0)
+			{
+				pPartition->file.willNeed();
+			}
+		}
+		next = m_towardGoal[next];
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           aStar
+//  Description:    A* with the straight line estimate, scaled as the
+//                  graph's was when written, mapping partitions as
+//                  the search reaches them.
+//  Arguments:      The start and goal as original node ids, and the
+//                  vector the path is written to, goal first, also as
+//                  original ids.
+//  Return Value:   true if the goal can be reached.
+// ----------------------------------------------------------------
+template<class ArcType>
+bool PartitionedGraph<ArcType>::aStar(NodeId start, NodeId dest, std::vector<NodeId>& path)
+{
+	for (size_t i = 0; i < m_touched.size(); i++)
+	{
+		m_state[m_touched[i]].reset();
+	}
+	m_touched.clear();
+
+	if (start >= nodeCount() || dest >= nodeCount())
+	{
+		return false;
+	}
+	NodeId from = m_pNewId[start];
+	NodeId to = m_pNewId[dest];
+	unsigned int goalPartition = partitionOf(to);
+	routeOverlay(goalPartition);
+	Partition* pGoal = partition(goalPartition);
+	if (pGoal == 0)
+	{
+		return false;
+	}
+	GraphPosition goalPos = pGoal->pPos[to - pGoal->firstNode];
+
+	PartitionSpace space = { *this };
+	BestFirstSearch<ArcType, PartitionSpace> bestFirst(space);
+	bestFirst.start(from, 0, 0);
+	std::vector<std::pair<NodeId, ArcType> > arcs;
+	bool failed = false;
+	PartitionArcs visit = { *this, arcs, failed };
+	NodeId found = bestFirst.run(visit, [&](NodeId child) -> ArcType
+	{
+		unsigned int childId = partitionOf(child);
+		Partition* pChild = partition(childId);
+		if (pChild == 0)
+		{
+			failed = true;
+			return 0;
+		}
+		return (ArcType)(m_header.scale * estimate(pChild->pPos[child - pChild->firstNode], goalPos));
+	}, [&](NodeId node) { return node == to; });
+	if (found == invalidNodeId())
+	{
+		return false;
+	}
+
+	for (NodeId node = to; node != invalidNodeId(); )
+	{
+		path.push_back(m_pOldId[node]);
+		unsigned int p = partitionOf(node);
+		node = m_state[p]->prev[node - m_pFirstNode[p]];
+	}
+	return true;
+}
+
+#endif
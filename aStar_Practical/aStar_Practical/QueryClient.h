@@ -0,0 +1,167 @@
+#ifndef QUERYCLIENT_H
+#define QUERYCLIENT_H
+
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "QueryProtocol.h"
+
+// ----------------------------------------------------------------
+//  Name:           QueryClient
+//  Description:    One connection to the query server (aStar_Server)
+//                  over a Unix domain socket. query() asks one thing
+//                  and waits for the answer. To keep many requests in
+//                  flight, call send() for each, flush() once and then
+//                  receive() as many answers, matching them up by id.
+//                  POSIX only. Not thread safe; use one client per
+//                  thread.
+// ----------------------------------------------------------------
+class QueryClient {
+private:
+	int m_socket;
+	unsigned int m_nextId;
+	std::vector<char> m_out;
+	std::vector<char> m_in;
+	size_t m_inStart;
+
+	QueryClient(QueryClient const &);
+	QueryClient& operator=(QueryClient const &);
+
+	bool fill(size_t bytes)
+	{
+		if (m_in.size() - m_inStart < bytes && m_inStart > 0)
+		{
+			m_in.erase(m_in.begin(), m_in.begin() + m_inStart);
+			m_inStart = 0;
+		}
+		while (m_in.size() - m_inStart < bytes)
+		{
+			char buffer[64 * 1024];
+			ssize_t got = ::recv(m_socket, buffer, sizeof(buffer), 0);
+			if (got <= 0)
+			{
+				return false;
+			}
+			m_in.insert(m_in.end(), buffer, buffer + got);
+		}
+		return true;
+	}
+
+public:
+	QueryClient() : m_socket(-1), m_nextId(0), m_inStart(0) {}
+
+	~QueryClient()
+	{
+		close();
+	}
+
+	bool isOpen() const
+	{
+		return m_socket >= 0;
+	}
+
+	bool connect(std::string const & socketPath)
+	{
+		close();
+		sockaddr_un address = sockaddr_un();
+		if (socketPath.size() >= sizeof(address.sun_path))
+		{
+			return false;
+		}
+		address.sun_family = AF_UNIX;
+		socketPath.copy(address.sun_path, socketPath.size());
+		m_socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_socket < 0)
+		{
+			return false;
+		}
+		if (::connect(m_socket, (sockaddr const *)&address, sizeof(address)) != 0)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		if (m_socket >= 0)
+		{
+			::close(m_socket);
+			m_socket = -1;
+		}
+		m_out.clear();
+		m_in.clear();
+		m_inStart = 0;
+	}
+
+	// Queues a request and returns the id its answer will carry.
+	unsigned int send(NodeId start, NodeId goal)
+	{
+		QueryRequest request = { m_nextId++, start, goal };
+		QueryFrame::encode(request, m_out);
+		return request.id;
+	}
+
+	bool flush()
+	{
+		size_t sent = 0;
+		while (sent < m_out.size())
+		{
+			ssize_t wrote = ::send(m_socket, &m_out[sent], m_out.size() - sent, MSG_NOSIGNAL);
+			if (wrote <= 0)
+			{
+				return false;
+			}
+			sent += (size_t)wrote;
+		}
+		m_out.clear();
+		return true;
+	}
+
+	// Waits for the next answer, whichever request it is for.
+	bool receive(QueryResponse& response)
+	{
+		if (!fill(4))
+		{
+			return false;
+		}
+		unsigned int length = QueryFrame::get32(&m_in[m_inStart]);
+		if (length > queryMaxFrameBytes || !fill(4 + length))
+		{
+			return false;
+		}
+		bool ok = QueryFrame::decode(&m_in[m_inStart + 4], length, response);
+		m_inStart += 4 + length;
+		if (m_inStart == m_in.size())
+		{
+			m_in.clear();
+			m_inStart = 0;
+		}
+		return ok;
+	}
+
+	bool query(NodeId start, NodeId goal, QueryResponse& response)
+	{
+		unsigned int id = send(start, goal);
+		if (!flush())
+		{
+			return false;
+		}
+		// skip answers to anything sent earlier and not yet received.
+		do
+		{
+			if (!receive(response))
+			{
+				return false;
+			}
+		} while (response.id != id);
+		return true;
+	}
+};
+
+#endif
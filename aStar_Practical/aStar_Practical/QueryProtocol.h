@@ -0,0 +1,135 @@
+#ifndef QUERYPROTOCOL_H
+#define QUERYPROTOCOL_H
+
+#include <cstring>
+#include <vector>
+
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Query server wire format. Every frame starts with a 32 bit count of
+//  the bytes after it. Fields are 32 or 64 bit integers in the host's
+//  byte order, since both ends are on the same machine.
+//
+//  Request:    length (12), id, start, goal
+//  Response:   length, id, status, cost (64 bit), count, count node
+//              ids from the goal back to the start
+//
+//  Ids are the client's own and are sent back unchanged, so a client
+//  can have many requests in flight on one connection; answers to
+//  them may come back in any order. A frame whose length is not that
+//  of a request makes the server drop the connection.
+// ----------------------------------------------------------------
+
+enum QueryStatus {
+	QUERY_OK = 0,
+	QUERY_NO_PATH = 1,
+	QUERY_BAD_NODE = 2
+};
+
+struct QueryRequest {
+	unsigned int id;
+	NodeId start;
+	NodeId goal;
+};
+
+struct QueryResponse {
+	unsigned int id;
+	unsigned int status;
+	long long cost;
+	std::vector<NodeId> path;
+};
+
+// Bytes in a request frame after its length, and the most a response
+// frame may claim, so a bad length cannot make a reader allocate
+// without limit.
+const unsigned int queryRequestBytes = 12;
+const unsigned int queryMaxFrameBytes = 64 * 1024 * 1024;
+
+// ----------------------------------------------------------------
+//  Name:           QueryFrame
+//  Description:    Appends and reads the fields of a frame.
+// ----------------------------------------------------------------
+struct QueryFrame {
+	static void put32(std::vector<char>& out, unsigned int value)
+	{
+		out.insert(out.end(), (char const *)&value, (char const *)&value + 4);
+	}
+
+	static void put64(std::vector<char>& out, long long value)
+	{
+		out.insert(out.end(), (char const *)&value, (char const *)&value + 8);
+	}
+
+	static unsigned int get32(char const * pIn)
+	{
+		unsigned int value;
+		std::memcpy(&value, pIn, 4);
+		return value;
+	}
+
+	static long long get64(char const * pIn)
+	{
+		long long value;
+		std::memcpy(&value, pIn, 8);
+		return value;
+	}
+
+	static void encode(QueryRequest const & request, std::vector<char>& out)
+	{
+		put32(out, queryRequestBytes);
+		put32(out, request.id);
+		put32(out, request.start);
+		put32(out, request.goal);
+	}
+
+	static void encode(QueryResponse const & response, std::vector<char>& out)
+	{
+		put32(out, (unsigned int)(20 + response.path.size() * 4));
+		put32(out, response.id);
+		put32(out, response.status);
+		put64(out, response.cost);
+		put32(out, (unsigned int)response.path.size());
+		for (size_t i = 0; i < response.path.size(); i++)
+		{
+			put32(out, response.path[i]);
+		}
+	}
+
+	// Both decoders take a frame's bytes after its length.
+	static bool decode(char const * pIn, unsigned int length, QueryRequest& request)
+	{
+		if (length != queryRequestBytes)
+		{
+			return false;
+		}
+		request.id = get32(pIn);
+		request.start = get32(pIn + 4);
+		request.goal = get32(pIn + 8);
+		return true;
+	}
+
+	static bool decode(char const * pIn, unsigned int length, QueryResponse& response)
+	{
+		if (length < 20)
+		{
+			return false;
+		}
+		unsigned int count = get32(pIn + 16);
+		if (length != 20 + (unsigned long long)count * 4)
+		{
+			return false;
+		}
+		response.id = get32(pIn);
+		response.status = get32(pIn + 4);
+		response.cost = get64(pIn + 8);
+		response.path.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			response.path[i] = get32(pIn + 20 + i * 4);
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef SEARCHTREECACHE_H
+#define SEARCHTREECACHE_H
+
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "Graph.h"
+
+// ----------------------------------------------------------------
+//  Name:           OriginSearchTree
+//  Description:    A uniform cost search from one origin that is
+//                  kept after it stops. The search only runs until
+//                  the goal asked for is settled; a later goal that
+//                  is already settled is answered straight from the
+//                  tree, and one that is not yet settled resumes the
+//                  search from where it stopped.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class OriginSearchTree {
+private:
+	typedef GraphArc<NodeType, ArcType> Arc;
+	typedef GraphNode<NodeType, ArcType> Node;
+
+	struct OpenEntry {
+		ArcType costDist;
+		int node;
+
+		bool operator>(OpenEntry const & other) const
+		{
+			return costDist > other.costDist;
+		}
+	};
+
+	Graph<NodeType, ArcType>& m_graph;
+	int m_origin;
+	int m_settledCount;
+
+	std::vector<ArcType> m_costDist;
+	std::vector<int> m_prev;
+	std::vector<char> m_settled;
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > m_open;
+
+public:
+	static ArcType unreachable()
+	{
+		return numeric_limits<ArcType>::max();
+	}
+
+	OriginSearchTree(Graph<NodeType, ArcType>& graph, int origin)
+		: m_graph(graph), m_origin(origin), m_settledCount(0),
+		m_costDist(graph.maxNodes(), unreachable()), m_prev(graph.maxNodes(), -1), m_settled(graph.maxNodes(), false)
+	{
+		m_costDist[origin] = 0;
+		OpenEntry first = { 0, origin };
+		m_open.push(first);
+	}
+
+	int origin() const
+	{
+		return m_origin;
+	}
+
+	int settledCount() const
+	{
+		return m_settledCount;
+	}
+
+	bool settled(int index) const
+	{
+		return m_settled[index] != 0;
+	}
+
+	ArcType costDist(int index) const
+	{
+		return m_settled[index] ? m_costDist[index] : unreachable();
+	}
+
+// ----------------------------------------------------------------
+//  Name:           settle
+//  Description:    Carries on the search until the goal is settled
+//                  or there is nothing left to expand.
+//  Arguments:      The goal's node index.
+//  Return Value:   true if the goal can be reached.
+// ----------------------------------------------------------------
+	bool settle(int goal)
+	{
+		while (!m_settled[goal] && !m_open.empty())
+		{
+			OpenEntry top = m_open.top();
+			m_open.pop();
+			if (m_settled[top.node] || top.costDist != m_costDist[top.node])
+			{
+				continue;
+			}
+			m_settled[top.node] = true;
+			m_settledCount++;
+
+			Node* pNode = m_graph.nodeArray()[top.node];
+			typename list<Arc>::const_iterator iter = pNode->arcList().begin();
+			for (; iter != pNode->arcList().end(); ++iter)
+			{
+				int child = (*iter).node()->index();
+				ArcType dist = top.costDist + (*iter).weight();
+				if (dist < m_costDist[child])
+				{
+					m_costDist[child] = dist;
+					m_prev[child] = top.node;
+					OpenEntry entry = { dist, child };
+					m_open.push(entry);
+				}
+			}
+		}
+		return m_settled[goal] != 0;
+	}
+
+	// Writes the path to a settled goal, goal first like Graph::ucs.
+	void path(int goal, std::vector<Node*>& path) const
+	{
+		if (m_settled[goal])
+		{
+			for (int index = goal; index != -1; index = m_prev[index])
+			{
+				path.push_back(m_graph.nodeArray()[index]);
+			}
+		}
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           SearchTreeCache
+//  Description:    Keeps the search trees of the most recently used
+//                  origins, up to a fixed number, and throws out the
+//                  least recently used one to make room. Each tree
+//                  holds a few arrays the size of the graph, so the
+//                  capacity bounds the memory used. Any edit to the
+//                  graph makes every tree stale, so they are all
+//                  dropped.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class SearchTreeCache : public Graph<NodeType, ArcType>::Listener {
+private:
+	typedef GraphNode<NodeType, ArcType> Node;
+	typedef OriginSearchTree<NodeType, ArcType> Tree;
+	typedef std::list<std::shared_ptr<Tree> > TreeList;
+
+	Graph<NodeType, ArcType>& m_graph;
+	size_t m_capacity;
+
+// ----------------------------------------------------------------
+//  Description:    Trees with the most recently used at the front,
+//                  and where to find each origin's tree in the list.
+// ----------------------------------------------------------------
+	TreeList m_trees;
+	std::map<int, typename TreeList::iterator> m_byOrigin;
+
+	SearchTreeCache(SearchTreeCache const &);
+	SearchTreeCache& operator=(SearchTreeCache const &);
+
+public:
+	SearchTreeCache(Graph<NodeType, ArcType>& graph, size_t capacity) : m_graph(graph), m_capacity(capacity)
+	{
+		m_graph.addListener(this);
+	}
+
+	~SearchTreeCache()
+	{
+		m_graph.removeListener(this);
+	}
+
+	size_t size() const
+	{
+		return m_trees.size();
+	}
+
+	void clear()
+	{
+		m_trees.clear();
+		m_byOrigin.clear();
+	}
+
+	// Finds the origin's tree, making a new one if needed, and moves it
+	// to the front of the list.
+	Tree& tree(int origin)
+	{
+		typename std::map<int, typename TreeList::iterator>::iterator found = m_byOrigin.find(origin);
+		if (found != m_byOrigin.end())
+		{
+			m_trees.splice(m_trees.begin(), m_trees, found->second);
+			return *m_trees.front();
+		}
+
+		if (m_trees.size() >= m_capacity && !m_trees.empty())
+		{
+			m_byOrigin.erase(m_trees.back()->origin());
+			m_trees.pop_back();
+		}
+		m_trees.push_front(std::shared_ptr<Tree>(new Tree(m_graph, origin)));
+		m_byOrigin[origin] = m_trees.begin();
+		return *m_trees.front();
+	}
+
+// ----------------------------------------------------------------
+//  Name:           findPath
+//  Description:    Answers a query from the origin's tree.
+//  Arguments:      The origin and goal nodes and the vector the path
+//                  is written to, goal first like Graph::ucs.
+//  Return Value:   true if the goal can be reached.
+// ----------------------------------------------------------------
+	bool findPath(Node* pOrigin, Node* pGoal, std::vector<Node*>& path)
+	{
+		Tree& originTree = tree(pOrigin->index());
+		if (!originTree.settle(pGoal->index()))
+		{
+			return false;
+		}
+		originTree.path(pGoal->index(), path);
+		return true;
+	}
+
+	ArcType cost(Node* pOrigin, Node* pGoal)
+	{
+		Tree& originTree = tree(pOrigin->index());
+		originTree.settle(pGoal->index());
+		return originTree.costDist(pGoal->index());
+	}
+
+	// Graph::Listener
+	void nodeAdded(int index) { clear(); }
+	void nodeRemoved(int index) { clear(); }
+	void arcAdded(int from, int to, ArcType weight) { clear(); }
+	void arcRemoved(int from, int to) { clear(); }
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef TEXTGRAPH_H
+#define TEXTGRAPH_H
+
+#include <map>
+#include <string>
+
+#include "GraphImport.h"
+#include "IndexedGraph.h"
+
+// ----------------------------------------------------------------
+//  Name:           loadTextGraph
+//  Description:    Loads the visualiser's two file layout straight
+//                  into an IndexedGraph: a nodes file of "name x y"
+//                  lines, whose line order gives the node ids, and an
+//                  arcs file of "from to weight" lines by id. Arcs to
+//                  or from ids past the last node are skipped. Both
+//                  files go through GraphImporter.
+//  Arguments:      The two file names, the graph to fill, if not null
+//                  a map to fill from node name to id, and the number
+//                  of threads to parse with.
+//  Return Value:   false if either file could not be read.
+// ----------------------------------------------------------------
+template<class ArcType>
+bool loadTextGraph(std::string const & nodesFile, std::string const & arcsFile, IndexedGraph<std::string, ArcType>& graph,
+	std::map<std::string, NodeId>* pByName, int threads = 1)
+{
+	GraphImporter<std::string, ArcType> importer(threads);
+	if (!importer.importNodes(nodesFile) || !importer.importArcs(arcsFile, IMPORT_EDGE_LIST) || !importer.build(graph))
+	{
+		return false;
+	}
+	if (pByName != 0)
+	{
+		for (NodeId n = 0; n < graph.nodeCount(); n++)
+		{
+			(*pByName)[graph.data(n)] = n;
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef TIMESLICEDSEARCH_H
+#define TIMESLICEDSEARCH_H
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "Graph.h"
+#include "AsyncSearch.h"
+
+// ----------------------------------------------------------------
+//  Name:           TimeSlicedSearch
+//  Description:    An A* search that can be run a little at a time.
+//                  Each call to step() expands at most a given number
+//                  of nodes or runs for at most a given time, and the
+//                  open and closed sets are kept in the search object
+//                  between calls. Because none of the state is kept
+//                  in the nodes, any number of these searches can run
+//                  over the same graph at once. The graph must not be
+//                  edited while a search is in progress.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class TimeSlicedSearch {
+public:
+	enum State { Searching, PathFound, NoPath };
+
+private:
+	typedef GraphArc<NodeType, ArcType> Arc;
+	typedef GraphNode<NodeType, ArcType> Node;
+
+	// f cost and node index, smallest f on top of the queue.
+	typedef std::pair<int, int> OpenEntry;
+
+	Graph<NodeType, ArcType>& m_graph;
+	Node* m_pStart;
+	Node* m_pDest;
+	State m_state;
+	int m_expanded;
+	float m_scale;
+
+// ----------------------------------------------------------------
+//  Description:    Per node search state, indexed by node index.
+//                  m_prev is -1 for the start and unreached nodes.
+// ----------------------------------------------------------------
+	std::vector<int> m_costDist;
+	std::vector<int> m_estGoalDist;
+	std::vector<int> m_prev;
+	std::vector<char> m_closed;
+
+// ----------------------------------------------------------------
+//  Description:    The open list. A node is pushed again whenever
+//                  its cost improves and stale entries are skipped
+//                  when they reach the top.
+// ----------------------------------------------------------------
+	std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > m_open;
+
+	static int unreached()
+	{
+		return numeric_limits<int>::max();
+	}
+
+	int estimate(Node* pNode)
+	{
+		int index = pNode->index();
+		if (m_estGoalDist[index] < 0)
+		{
+			float x = m_pDest->getPos().x - pNode->getPos().x;
+			float y = m_pDest->getPos().y - pNode->getPos().y;
+			m_estGoalDist[index] = (int)(m_scale * sqrt(x * x + y * y));
+		}
+		return m_estGoalDist[index];
+	}
+
+	// Expands the best open node. Returns false once the search is over.
+	bool expandNext()
+	{
+		while (!m_open.empty() && m_closed[m_open.top().second])
+		{
+			m_open.pop();
+		}
+		if (m_open.empty())
+		{
+			m_state = NoPath;
+			return false;
+		}
+
+		int current = m_open.top().second;
+		m_open.pop();
+		m_closed[current] = true;
+		if (current == m_pDest->index())
+		{
+			m_state = PathFound;
+			return false;
+		}
+		m_expanded++;
+
+		Node* pCurrent = m_graph.nodeArray()[current];
+		typename list<Arc>::const_iterator child = pCurrent->arcList().begin();
+		typename list<Arc>::const_iterator endchild = pCurrent->arcList().end();
+		for (; child != endchild; child++)
+		{
+			Node* pChild = (*child).node();
+			int index = pChild->index();
+			int dist = m_costDist[current] + (*child).weight();
+			if (dist < m_costDist[index])
+			{
+				m_costDist[index] = dist;
+				m_prev[index] = current;
+				m_closed[index] = false;
+				m_open.push(OpenEntry(dist + estimate(pChild), index));
+			}
+		}
+		return true;
+	}
+
+public:
+	TimeSlicedSearch(Graph<NodeType, ArcType>& graph, Node* pStart, Node* pDest)
+		: m_graph(graph), m_pStart(pStart), m_pDest(pDest), m_state(Searching), m_expanded(0), m_scale(graph.heuristicScale()),
+		m_costDist(graph.maxNodes(), unreached()), m_estGoalDist(graph.maxNodes(), -1),
+		m_prev(graph.maxNodes(), -1), m_closed(graph.maxNodes(), false)
+	{
+		m_costDist[pStart->index()] = 0;
+		m_open.push(OpenEntry(estimate(pStart), pStart->index()));
+	}
+
+// ----------------------------------------------------------------
+//  Name:           step
+//  Description:    Continues the search from where the last call
+//                  stopped.
+//  Arguments:      The most nodes to expand and the most time to
+//                  spend in this call.
+//  Return Value:   The state of the search after the call.
+// ----------------------------------------------------------------
+	State step(int maxExpansions, std::chrono::microseconds maxTime)
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + maxTime;
+		for (int i = 0; i < maxExpansions && m_state == Searching; i++)
+		{
+			if (!expandNext() || std::chrono::steady_clock::now() >= end)
+			{
+				break;
+			}
+		}
+		return m_state;
+	}
+
+	State state() const
+	{
+		return m_state;
+	}
+
+	bool done() const
+	{
+		return m_state != Searching;
+	}
+
+	int expanded() const
+	{
+		return m_expanded;
+	}
+
+	Node* start() const
+	{
+		return m_pStart;
+	}
+
+	Node* dest() const
+	{
+		return m_pDest;
+	}
+
+	// Writes the path in the same order as Graph::aStar, goal first.
+	// Nothing is written unless the path has been found.
+	void path(std::vector<Node*>& path) const
+	{
+		if (m_state == PathFound)
+		{
+			for (int index = m_pDest->index(); index != -1; index = m_prev[index])
+			{
+				path.push_back(m_graph.nodeArray()[index]);
+			}
+		}
+	}
+
+	// Fills in a snapshot the same way a SearchJob does, so both kinds
+	// of search can be drawn by the same code.
+	void capture(SearchProgress& progress) const
+	{
+		int size = m_graph.maxNodes();
+		progress.costDist.assign(size, 0);
+		progress.estGoalDist.assign(size, 0);
+		progress.marked.assign(size, 0);
+		for (int i = 0; i < size; i++)
+		{
+			if (m_costDist[i] != unreached())
+			{
+				progress.costDist[i] = m_costDist[i];
+				progress.estGoalDist[i] = m_estGoalDist[i];
+				progress.marked[i] = true;
+			}
+		}
+		progress.expanded = m_expanded;
+		progress.finished = done();
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           SearchScheduler
+//  Description:    Shares a per frame time budget between any number
+//                  of TimeSlicedSearches, giving each a slice in turn
+//                  and carrying on from the same place next frame so
+//                  no search is starved.
+// ----------------------------------------------------------------
+template<class NodeType, class ArcType>
+class SearchScheduler {
+private:
+	typedef TimeSlicedSearch<NodeType, ArcType> Search;
+
+	std::vector<std::shared_ptr<Search> > m_searches;
+	size_t m_next;
+	int m_sliceExpansions;
+
+public:
+	SearchScheduler(int sliceExpansions) : m_next(0), m_sliceExpansions(sliceExpansions) {}
+
+	std::shared_ptr<Search> add(Graph<NodeType, ArcType>& graph, GraphNode<NodeType, ArcType>* pStart, GraphNode<NodeType, ArcType>* pDest)
+	{
+		std::shared_ptr<Search> search(new Search(graph, pStart, pDest));
+		m_searches.push_back(search);
+		return search;
+	}
+
+	// Drops a search before it has finished.
+	void remove(std::shared_ptr<Search> const & search)
+	{
+		for (size_t i = 0; i < m_searches.size(); i++)
+		{
+			if (m_searches[i] == search)
+			{
+				m_searches.erase(m_searches.begin() + i);
+				if (m_next > i)
+				{
+					m_next--;
+				}
+				return;
+			}
+		}
+	}
+
+	size_t active() const
+	{
+		return m_searches.size();
+	}
+
+// ----------------------------------------------------------------
+//  Name:           update
+//  Description:    Runs slices round robin until the budget is spent
+//                  or every search has finished. Finished searches
+//                  are dropped; callers keep the shared_ptr returned
+//                  by add() to collect the path.
+//  Arguments:      The time the scheduler may use this frame.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+	void update(std::chrono::microseconds budget)
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + budget;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		while (!m_searches.empty() && now < end)
+		{
+			if (m_next >= m_searches.size())
+			{
+				m_next = 0;
+			}
+
+			std::chrono::microseconds left = std::chrono::duration_cast<std::chrono::microseconds>(end - now);
+			if (m_searches[m_next]->step(m_sliceExpansions, left) != Search::Searching)
+			{
+				m_searches.erase(m_searches.begin() + m_next);
+			}
+			else
+			{
+				m_next++;
+			}
+			now = std::chrono::steady_clock::now();
+		}
+	}
+};
+
+#endif
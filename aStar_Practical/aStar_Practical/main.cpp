@@ -28,6 +28,8 @@
 #include <vector>
 
 #include "Graph.h"
+#include "AsyncSearch.h"
+#include "TimeSlicedSearch.h"
 
 using namespace std;
 
@@ -46,6 +48,7 @@ int main()
 {
 	// Create the main window 
 	sf::RenderWindow window(sf::VideoMode(800, 600, 32), "SFML First Program");
+	window.setFramerateLimit(60);
 
 	//load a font
 	sf::Font font;
@@ -70,6 +73,14 @@ int main()
 	vector<std::pair<sf::VertexArray, sf::Text>> arcs;//lines to draw arcs
 	vector<Node *> vecpath;//Optimal Path
 
+	SearchWorkerPool<string, int> searchPool(1);//Runs searches off the render thread
+	std::shared_ptr<SearchJob<string, int>> searchJob;//Search in flight, if any
+	SearchScheduler<string, int> scheduler(64);//Runs time sliced searches inside the frame
+	std::shared_ptr<TimeSlicedSearch<string, int>> slicedSearch;//Time sliced search in flight, if any
+	const std::chrono::microseconds frameSearchBudget(4000);
+	SearchProgress progress;//Node state drawn each frame
+	unsigned progressVersion = 0;
+
 	string c = "";
 	int i = 0;
 	ifstream myfile;
@@ -95,6 +106,7 @@ int main()
 		arcs.push_back(SetupEdges(myGraph.nodeArray()[from]->getPos(), myGraph.nodeArray()[to]->getPos(), weight, radius, &font));
 	}
 	myfile.close();
+	progress.capture(myGraph);
 
 	// Now traverse the graph.
 	while (window.isOpen())
@@ -115,6 +127,17 @@ int main()
 		if (sf::Keyboard::isKeyPressed(sf::Keyboard::R) && resetPressed == false)//Reset button
 		{
 			resetPressed = true;
+			if (searchJob)//stop the search before touching the nodes it is writing to
+			{
+				searchJob->cancel();
+				searchJob->wait();
+				searchJob.reset();
+			}
+			if (slicedSearch)
+			{
+				scheduler.remove(slicedSearch);
+				slicedSearch.reset();
+			}
 			originFound = false;
 			goalFound = false;
 			aStarDone = false;
@@ -130,6 +153,7 @@ int main()
 				myGraph.nodeArray()[i]->setPrevNode(nullptr);
 				nodes[i].first.setFillColor(sf::Color::White);
 			}
+			progress.capture(myGraph);
 		}
 		else if (!sf::Keyboard::isKeyPressed(sf::Keyboard::R) )
 		{
@@ -141,7 +165,15 @@ int main()
 			keyPressed = true;
 			if (origin != nullptr && goal != nullptr && goal != origin)
 			{
-				myGraph.aStar(origin, goal, visit, vecpath);//Do Astar
+				if (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift))
+				{
+					slicedSearch = scheduler.add(myGraph, origin, goal);//Do Astar a slice per frame
+				}
+				else
+				{
+					searchJob = searchPool.submit(myGraph, origin, goal, visit);//Do Astar on a worker
+					progressVersion = 0;
+				}
 				aStarDone = true;
 			}
 			else
@@ -158,6 +190,27 @@ int main()
 			keyPressed = false;
 		}
 
+		if (searchJob)//pick up the latest snapshot and the path once it is found
+		{
+			searchJob->progress(progress, progressVersion);
+			if (searchJob->ready())
+			{
+				vecpath = searchJob->result().get();
+				searchJob.reset();
+			}
+		}
+
+		scheduler.update(frameSearchBudget);
+		if (slicedSearch)
+		{
+			slicedSearch->capture(progress);
+			if (slicedSearch->done())
+			{
+				slicedSearch->path(vecpath);
+				slicedSearch.reset();
+			}
+		}
+
 		position = sf::Mouse::getPosition(window);
 
 		if (sf::Mouse::isButtonPressed(sf::Mouse::Left) && leftClicked == false)//Select Origin
@@ -220,8 +273,8 @@ int main()
 			sf::Text costDist;
 			costDist.setPosition(nodes[i].first.getPosition().x + radius / 2 - 2, nodes[i].first.getPosition().y + 10);
 			costDist.setCharacterSize(12);
-			costDist.setString("G(" + to_string(myGraph.nodeArray()[i]->getCostDist()) + ")");
-			if (myGraph.nodeArray()[i]->getCostDist() >= 999999 || myGraph.nodeArray()[i]->getCostDist() <= 0)
+			costDist.setString("G(" + to_string(progress.costDist[i]) + ")");
+			if (progress.costDist[i] >= 999999 || progress.costDist[i] <= 0)
 			{
 				costDist.setString("G(n)");
 			}
@@ -232,15 +285,15 @@ int main()
 			sf::Text estcostDist;
 			estcostDist.setPosition(nodes[i].first.getPosition().x + radius / 2 - 2, nodes[i].first.getPosition().y + 20);
 			estcostDist.setCharacterSize(12);
-			estcostDist.setString("H(" + to_string(myGraph.nodeArray()[i]->getEstGoalDist()) + ")");
-			if (myGraph.nodeArray()[i]->getEstGoalDist() <= 0)
+			estcostDist.setString("H(" + to_string(progress.estGoalDist[i]) + ")");
+			if (progress.estGoalDist[i] <= 0)
 			{
 				estcostDist.setString("H(n)");
 			}
 			estcostDist.setColor(sf::Color::Black);
 			estcostDist.setFont(font);
 
-			if (myGraph.nodeArray()[i]->marked())
+			if (progress.marked[i])
 			{
 				nodes[i].first.setFillColor(sf::Color::Magenta);
 			}
@@ -0,0 +1,131 @@
+// ----------------------------------------------------------------
+//  aStar_Query: answers shortest path queries from the command line
+//  without a window or SFML.
+//
+//  Usage:  aStar_Query <nodes file> <arcs file> [threads]
+//
+//  The files are in the same format the visualiser loads ("name x y"
+//  per node, "from to weight" per arc, by node index). Each line read
+//  from stdin is one query, "start goal" by node name. Each answer is
+//  one line on stdout, in the same order:
+//      <cost> <start> ... <goal>
+//      none                        if the goal cannot be reached
+//      error <message>             if the line is not a valid query
+//  Queries are read in batches of whatever input has already arrived,
+//  solved across the worker threads, and written out in order.
+// ----------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IndexedGraph.h"
+#include "TextGraph.h"
+
+using namespace std;
+
+typedef IndexedGraph<string, int> QueryGraph;
+
+// Most queries read before the batch is solved, even if more input
+// has already arrived.
+const size_t maxBatch = 4096;
+
+string answer(QueryGraph const & graph, map<string, NodeId> const & byName, string const & line, IndexedSearchSpace<int>& space)
+{
+	istringstream query(line);
+	string startName, goalName;
+	if (!(query >> startName >> goalName))
+	{
+		return "error expected \"start goal\"";
+	}
+	map<string, NodeId>::const_iterator start = byName.find(startName);
+	map<string, NodeId>::const_iterator goal = byName.find(goalName);
+	if (start == byName.end() || goal == byName.end())
+	{
+		return "error unknown node " + (start == byName.end() ? startName : goalName);
+	}
+
+	vector<NodeId> path;
+	if (!graph.aStar(start->second, goal->second, space, path))
+	{
+		return "none";
+	}
+	ostringstream out;
+	out << space.costDist(goal->second);
+	// paths come goal first.
+	for (size_t i = path.size(); i > 0; i--)
+	{
+		out << ' ' << graph.data(path[i - 1]);
+	}
+	return out.str();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "usage: aStar_Query <nodes file> <arcs file> [threads]" << endl;
+		return 2;
+	}
+	int threads = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+	threads = max(threads, 1);
+	ios::sync_with_stdio(false);
+
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	QueryGraph graph(0);
+	map<string, NodeId> byName;
+	if (!loadTextGraph(argv[1], argv[2], graph, &byName, threads))
+	{
+		cerr << "cannot read " << argv[1] << " or " << argv[2] << endl;
+		return 1;
+	}
+	cerr << "loaded " << graph.nodeCount() << " nodes and " << graph.arcCount() << " arcs in "
+		<< chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin).count() << " ms" << endl;
+
+	vector<IndexedSearchSpace<int> > spaces(threads);
+	vector<string> lines;
+	vector<string> answers;
+	string line;
+	while (getline(cin, line))
+	{
+		lines.push_back(line);
+		// keep reading while input is already waiting, so a piped file
+		// is answered in large batches and an interactive user at once.
+		if (lines.size() < maxBatch && cin.rdbuf()->in_avail() > 0)
+		{
+			continue;
+		}
+
+		answers.assign(lines.size(), string());
+		atomic<int> next(0);
+		vector<thread> workers;
+		for (int t = 0; t < threads && t < (int)lines.size(); t++)
+		{
+			workers.push_back(thread([&, t]()
+			{
+				for (int i = next++; i < (int)lines.size(); i = next++)
+				{
+					answers[i] = answer(graph, byName, lines[i], spaces[t]);
+				}
+			}));
+		}
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+		for (size_t i = 0; i < answers.size(); i++)
+		{
+			cout << answers[i] << '\n';
+		}
+		cout.flush();
+		lines.clear();
+	}
+	return 0;
+}
@@ -0,0 +1,129 @@
+// ----------------------------------------------------------------
+//  aStar_LoadGen: drives aStar_Server with random queries and reports
+//  the throughput and latency it saw.
+//
+//  Usage:  aStar_LoadGen <socket> <nodes> [connections] [depth] [seconds]
+//
+//  Each connection runs on its own thread and keeps [depth] requests
+//  in flight, between random nodes below <nodes>, topping up as
+//  answers come back. A depth of 1 measures plain round trip latency;
+//  higher depths show how well the server batches.
+//
+//  POSIX only:
+//      g++ -std=c++11 -O2 -pthread -I../aStar_Practical loadgen.cpp -o aStar_LoadGen
+// ----------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "QueryClient.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Totals {
+	unsigned long long answers;
+	unsigned long long noPath;
+	unsigned long long failed;
+	vector<unsigned long long> latency;
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "usage: aStar_LoadGen <socket> <nodes> [connections] [depth] [seconds]" << endl;
+		return 2;
+	}
+	string socketPath = argv[1];
+	NodeId nodes = (NodeId)max(atoi(argv[2]), 1);
+	int connections = (argc > 3) ? max(atoi(argv[3]), 1) : 4;
+	int depth = (argc > 4) ? max(atoi(argv[4]), 1) : 16;
+	double seconds = (argc > 5) ? atof(argv[5]) : 5;
+
+	vector<Totals> totals(connections);
+	Clock::time_point begin = Clock::now();
+	Clock::time_point end = begin + chrono::microseconds((long long)(seconds * 1e6));
+	vector<thread> clients;
+	for (int c = 0; c < connections; c++)
+	{
+		clients.push_back(thread([&, c]()
+		{
+			Totals& mine = totals[c];
+			mine.answers = mine.noPath = mine.failed = 0;
+			QueryClient client;
+			if (!client.connect(socketPath))
+			{
+				mine.failed++;
+				return;
+			}
+			mt19937 random(c * 7919 + 1);
+			uniform_int_distribution<NodeId> pick(0, nodes - 1);
+			// when each request in flight was sent, by id.
+			unordered_map<unsigned int, Clock::time_point> sent;
+			QueryResponse response;
+			while (true)
+			{
+				bool more = Clock::now() < end;
+				while (more && (int)sent.size() < depth)
+				{
+					NodeId start = pick(random);
+					NodeId goal = pick(random);
+					sent[client.send(start, goal)] = Clock::now();
+				}
+				if (sent.empty())
+				{
+					return;
+				}
+				unordered_map<unsigned int, Clock::time_point>::iterator found;
+				if (!client.flush() || !client.receive(response) || (found = sent.find(response.id)) == sent.end())
+				{
+					mine.failed += sent.size();
+					return;
+				}
+				mine.answers++;
+				if (response.status != QUERY_OK)
+				{
+					mine.noPath++;
+				}
+				mine.latency.push_back((unsigned long long)chrono::duration_cast<chrono::microseconds>(Clock::now() - found->second).count());
+				sent.erase(found);
+			}
+		}));
+	}
+	for (size_t c = 0; c < clients.size(); c++)
+	{
+		clients[c].join();
+	}
+	double elapsed = chrono::duration<double>(Clock::now() - begin).count();
+
+	unsigned long long answers = 0, noPath = 0, failed = 0;
+	vector<unsigned long long> latency;
+	for (size_t c = 0; c < totals.size(); c++)
+	{
+		answers += totals[c].answers;
+		noPath += totals[c].noPath;
+		failed += totals[c].failed;
+		latency.insert(latency.end(), totals[c].latency.begin(), totals[c].latency.end());
+	}
+	sort(latency.begin(), latency.end());
+	cout << "answers " << answers << " (" << noPath << " without a path), failed " << failed << '\n'
+		<< "throughput_qps " << answers / elapsed << '\n';
+	if (!latency.empty())
+	{
+		cout << "latency_us p50 " << latency[latency.size() / 2]
+			<< " p90 " << latency[latency.size() * 9 / 10]
+			<< " p99 " << latency[latency.size() * 99 / 100]
+			<< " max " << latency.back() << '\n';
+	}
+	return failed > 0 ? 1 : 0;
+}
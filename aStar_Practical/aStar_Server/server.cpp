@@ -0,0 +1,691 @@
+// ----------------------------------------------------------------
+//  aStar_Server: a long running shortest path daemon. The graph is
+//  loaded once and shared read only by every worker thread, and
+//  queries arrive over a Unix domain socket in the binary format of
+//  QueryProtocol.h (QueryClient.h is the client side).
+//
+//  Usage:  aStar_Server <nodes file> <arcs file> <socket> [threads] [batch]
+//
+//  The files are the visualiser's "name x y" nodes and "from to
+//  weight" arcs, or DIMACS .co and .gr, or CSV "id,x,y" and
+//  "from,to,weight" (see GraphImport.h).
+//
+//  One thread polls every connection: it reads requests and queues
+//  them, and sends the answers, without ever blocking on a slow
+//  client. Each worker takes up to [batch] queued requests at a time,
+//  solves them and hands the answers for each connection over in one
+//  piece, so a busy server makes fewer, larger system calls. A client
+//  with too many requests unanswered or answers unread is not read
+//  from until it catches up. Latency and
+//  throughput are served as text on "<socket>.stats"; any connection
+//  there gets one report and is closed (e.g. "nc -U <socket>.stats").
+//  SIGINT or SIGTERM stops the server and removes both sockets.
+//
+//  POSIX only:
+//      g++ -std=c++11 -O2 -pthread -I../aStar_Practical server.cpp -o aStar_Server
+// ----------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "GraphImport.h"
+#include "IndexedGraph.h"
+#include "QueryProtocol.h"
+#include "TextGraph.h"
+
+using namespace std;
+
+typedef IndexedGraph<string, int> QueryGraph;
+typedef chrono::steady_clock Clock;
+
+volatile sig_atomic_t stopping = 0;
+
+void onStop(int)
+{
+	stopping = 1;
+}
+
+// A connection stops being read while this many of its requests are
+// waiting for an answer, or this many bytes of answers are waiting to
+// go out, so a client that sends faster than it reads holds back only
+// itself.
+const size_t maxInFlight = 1024;
+const size_t maxUnsent = 1024 * 1024;
+
+// ----------------------------------------------------------------
+//  One client connection, with a non-blocking socket. Only the poll
+//  thread reads, writes or closes the socket; workers append answers
+//  to the output buffer under its mutex and the poll thread sends
+//  them as the socket takes them. The socket is closed when the last
+//  reference goes, which may be a batch still holding a request.
+// ----------------------------------------------------------------
+struct Connection {
+	int socket;
+	vector<char> in;
+	bool reading;
+	atomic<size_t> inFlight;
+	mutex outMutex;
+	vector<char> out;
+	atomic<bool> broken;
+
+	explicit Connection(int s) : socket(s), reading(true), inFlight(0), broken(false) {}
+
+	~Connection()
+	{
+		::close(socket);
+	}
+
+	// Queues answers and says whether the buffer was empty, in which
+	// case the poll thread needs waking to send them.
+	bool append(vector<char> const & answers)
+	{
+		lock_guard<mutex> lock(outMutex);
+		bool wasEmpty = out.empty();
+		out.insert(out.end(), answers.begin(), answers.end());
+		return wasEmpty;
+	}
+
+	size_t unsent()
+	{
+		lock_guard<mutex> lock(outMutex);
+		return out.size();
+	}
+
+	// Sends as much as the socket will take without blocking.
+	// false if the connection has failed.
+	bool flush()
+	{
+		lock_guard<mutex> lock(outMutex);
+		size_t sent = 0;
+		while (sent < out.size())
+		{
+			ssize_t wrote = ::send(socket, &out[sent], out.size() - sent, MSG_NOSIGNAL);
+			if (wrote < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			{
+				break;
+			}
+			if (wrote <= 0)
+			{
+				broken = true;
+				out.clear();
+				return false;
+			}
+			sent += (size_t)wrote;
+		}
+		out.erase(out.begin(), out.begin() + sent);
+		return true;
+	}
+};
+
+// ----------------------------------------------------------------
+//  A pipe the workers write a byte to when they have answers for the
+//  poll thread to send, since poll cannot wait on a mutex.
+// ----------------------------------------------------------------
+class Waker {
+private:
+	int m_pipe[2];
+
+public:
+	Waker()
+	{
+		if (::pipe(m_pipe) != 0)
+		{
+			m_pipe[0] = m_pipe[1] = -1;
+			return;
+		}
+		::fcntl(m_pipe[0], F_SETFL, O_NONBLOCK);
+		::fcntl(m_pipe[1], F_SETFL, O_NONBLOCK);
+	}
+
+	~Waker()
+	{
+		::close(m_pipe[0]);
+		::close(m_pipe[1]);
+	}
+
+	int fd() const
+	{
+		return m_pipe[0];
+	}
+
+	// A full pipe already means a wake is due, so a failed write is fine.
+	void notify()
+	{
+		char byte = 0;
+		ssize_t ignored = ::write(m_pipe[1], &byte, 1);
+		(void)ignored;
+	}
+
+	void drain()
+	{
+		char buffer[256];
+		while (::read(m_pipe[0], buffer, sizeof(buffer)) > 0)
+		{
+		}
+	}
+};
+
+struct Pending {
+	shared_ptr<Connection> pConnection;
+	QueryRequest request;
+	Clock::time_point arrived;
+};
+
+// ----------------------------------------------------------------
+//  Counters for the stats endpoint. Latency runs from a request being
+//  read to its answer being queued for sending, and goes into power of
+//  two buckets of microseconds, so percentiles are accurate to within
+//  a factor of two at no cost to the workers beyond one atomic add.
+// ----------------------------------------------------------------
+struct Stats {
+	static const int buckets = 40;
+
+	Clock::time_point started;
+	atomic<unsigned long long> requests;
+	atomic<unsigned long long> batches;
+	atomic<unsigned long long> noPath;
+	atomic<unsigned long long> badNode;
+	atomic<unsigned long long> connections;
+	atomic<unsigned long long> latency[buckets];
+	atomic<unsigned long long> maxLatency;
+
+	Stats() : started(Clock::now()), requests(0), batches(0), noPath(0), badNode(0), connections(0), maxLatency(0)
+	{
+		for (int i = 0; i < buckets; i++)
+		{
+			latency[i] = 0;
+		}
+	}
+
+	void record(unsigned long long micros)
+	{
+		int bucket = 0;
+		while (bucket < buckets - 1 && (1ull << bucket) <= micros)
+		{
+			bucket++;
+		}
+		latency[bucket]++;
+		unsigned long long seen = maxLatency;
+		while (micros > seen && !maxLatency.compare_exchange_weak(seen, micros))
+		{
+		}
+	}
+
+	// The upper bound of the bucket holding the given fraction of
+	// requests, or the slowest request if that is lower.
+	unsigned long long percentile(double fraction) const
+	{
+		unsigned long long total = 0;
+		for (int i = 0; i < buckets; i++)
+		{
+			total += latency[i];
+		}
+		unsigned long long wanted = (unsigned long long)(total * fraction);
+		unsigned long long seen = 0;
+		for (int i = 0; i < buckets; i++)
+		{
+			seen += latency[i];
+			if (seen > wanted)
+			{
+				return min(1ull << i, (unsigned long long)maxLatency);
+			}
+		}
+		return 0;
+	}
+
+	string report(size_t queued) const
+	{
+		double seconds = chrono::duration<double>(Clock::now() - started).count();
+		unsigned long long served = requests;
+		ostringstream out;
+		out << "uptime_s " << seconds << '\n'
+			<< "connections " << connections << '\n'
+			<< "queued " << queued << '\n'
+			<< "requests " << served << '\n'
+			<< "no_path " << noPath << '\n'
+			<< "bad_node " << badNode << '\n'
+			<< "batches " << batches << '\n'
+			<< "mean_batch " << (batches > 0 ? (double)served / batches : 0.0) << '\n'
+			<< "throughput_qps " << (seconds > 0 ? served / seconds : 0.0) << '\n'
+			<< "latency_p50_us " << percentile(0.5) << '\n'
+			<< "latency_p90_us " << percentile(0.9) << '\n'
+			<< "latency_p99_us " << percentile(0.99) << '\n'
+			<< "latency_max_us " << maxLatency << '\n';
+		return out.str();
+	}
+};
+
+// ----------------------------------------------------------------
+//  The queue between the reading thread and the workers.
+// ----------------------------------------------------------------
+class RequestQueue {
+private:
+	deque<Pending> m_pending;
+	mutable mutex m_mutex;
+	condition_variable m_wake;
+	bool m_stopped;
+
+public:
+	RequestQueue() : m_stopped(false) {}
+
+	void push(vector<Pending>& arrived)
+	{
+		if (arrived.empty())
+		{
+			return;
+		}
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_pending.insert(m_pending.end(), arrived.begin(), arrived.end());
+		}
+		if (arrived.size() == 1)
+		{
+			m_wake.notify_one();
+		}
+		else
+		{
+			m_wake.notify_all();
+		}
+		arrived.clear();
+	}
+
+	// Waits for work and takes a share of it: up to maxBatch requests,
+	// but no more than an even split between the workers, so a burst
+	// is spread out rather than taken whole by whichever wakes first.
+	bool pop(vector<Pending>& batch, size_t maxBatch, size_t workers)
+	{
+		unique_lock<mutex> lock(m_mutex);
+		while (m_pending.empty() && !m_stopped)
+		{
+			m_wake.wait(lock);
+		}
+		if (m_pending.empty())
+		{
+			return false;
+		}
+		size_t take = min(maxBatch, max((size_t)1, (m_pending.size() + workers - 1) / workers));
+		batch.assign(m_pending.begin(), m_pending.begin() + take);
+		m_pending.erase(m_pending.begin(), m_pending.begin() + take);
+		return true;
+	}
+
+	size_t size() const
+	{
+		lock_guard<mutex> lock(m_mutex);
+		return m_pending.size();
+	}
+
+	void stop()
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_stopped = true;
+		}
+		m_wake.notify_all();
+	}
+};
+
+// ----------------------------------------------------------------
+//  Name:           work
+//  Description:    A worker: answers batches until the queue stops.
+//                  Answers are grouped by connection and each group
+//                  is handed to the poll thread in one append.
+//  Arguments:      The graph, queue, stats, batch limits and the
+//                  poll thread's waker.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+void work(QueryGraph const & graph, RequestQueue& queue, Stats& stats, size_t maxBatch, size_t workers, Waker& waker)
+{
+	IndexedSearchSpace<int> space;
+	vector<Pending> batch;
+	map<Connection*, vector<char> > out;
+	QueryResponse response;
+	while (queue.pop(batch, maxBatch, workers))
+	{
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			QueryRequest const & request = batch[i].request;
+			response.id = request.id;
+			response.cost = 0;
+			response.path.clear();
+			if (batch[i].pConnection->broken)
+			{
+				continue;
+			}
+			if (request.start >= graph.nodeCount() || request.goal >= graph.nodeCount())
+			{
+				response.status = QUERY_BAD_NODE;
+				stats.badNode++;
+			}
+			else if (graph.aStar(request.start, request.goal, space, response.path))
+			{
+				response.status = QUERY_OK;
+				response.cost = space.costDist(request.goal);
+			}
+			else
+			{
+				response.status = QUERY_NO_PATH;
+				stats.noPath++;
+			}
+			QueryFrame::encode(response, out[batch[i].pConnection.get()]);
+		}
+
+		bool wake = false;
+		for (map<Connection*, vector<char> >::iterator i = out.begin(); i != out.end(); ++i)
+		{
+			wake = i->first->append(i->second) || wake;
+		}
+		out.clear();
+		// only once the answers are queued, so the poll thread never
+		// sees a connection with nothing in flight and nothing to send
+		// while its answers are still on their way.
+		Clock::time_point now = Clock::now();
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			batch[i].pConnection->inFlight--;
+			stats.record((unsigned long long)chrono::duration_cast<chrono::microseconds>(now - batch[i].arrived).count());
+		}
+		stats.requests += batch.size();
+		stats.batches++;
+		batch.clear();
+		if (wake)
+		{
+			waker.notify();
+		}
+	}
+}
+
+// Goes by the arcs file's name: DIMACS and CSV go to GraphImporter,
+// anything else is taken as the visualiser's layout.
+bool loadGraph(string const & nodesFile, string const & arcsFile, QueryGraph& graph, int threads)
+{
+	if (GraphImporter<string, int>::formatOf(arcsFile) == IMPORT_EDGE_LIST)
+	{
+		return loadTextGraph(nodesFile, arcsFile, graph, 0, threads);
+	}
+	GraphImporter<string, int> importer(threads);
+	if (!importer.importPositions(nodesFile) || !importer.importArcs(arcsFile) || !importer.build(graph))
+	{
+		cerr << importer.error() << endl;
+		return false;
+	}
+	return true;
+}
+
+int listenOn(string const & path)
+{
+	sockaddr_un address = sockaddr_un();
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		return -1;
+	}
+	address.sun_family = AF_UNIX;
+	path.copy(address.sun_path, path.size());
+	int s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0)
+	{
+		return -1;
+	}
+	::unlink(path.c_str());
+	if (::bind(s, (sockaddr const *)&address, sizeof(address)) != 0 || ::listen(s, 128) != 0)
+	{
+		::close(s);
+		return -1;
+	}
+	return s;
+}
+
+// ----------------------------------------------------------------
+//  Name:           readFrames
+//  Description:    Reads what has arrived on a connection into its
+//                  input buffer. The client shutting its side stops
+//                  the reading; its requests are still answered.
+//  Arguments:      The connection.
+//  Return Value:   false if the connection failed.
+// ----------------------------------------------------------------
+bool readFrames(Connection& connection)
+{
+	char buffer[64 * 1024];
+	ssize_t got = ::recv(connection.socket, buffer, sizeof(buffer), 0);
+	if (got < 0)
+	{
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	if (got == 0)
+	{
+		connection.reading = false;
+		return true;
+	}
+	connection.in.insert(connection.in.end(), buffer, buffer + got);
+	return true;
+}
+
+// ----------------------------------------------------------------
+//  Name:           takeFrames
+//  Description:    Queues the whole requests in a connection's input
+//                  buffer, up to its in flight limit. The rest wait
+//                  in the buffer for answers to make room.
+//  Arguments:      The connection, the time of reading and the list
+//                  to add requests to.
+//  Return Value:   false if the connection sent a frame that is not a
+//                  request, after which it is dropped.
+// ----------------------------------------------------------------
+bool takeFrames(shared_ptr<Connection> const & pConnection, Clock::time_point now, vector<Pending>& arrived)
+{
+	Connection& connection = *pConnection;
+	vector<char>& in = connection.in;
+	size_t used = 0;
+	while (in.size() - used >= 4 && connection.inFlight < maxInFlight)
+	{
+		unsigned int length = QueryFrame::get32(&in[used]);
+		if (length != queryRequestBytes)
+		{
+			return false;
+		}
+		if (in.size() - used < 4 + length)
+		{
+			break;
+		}
+		Pending pending;
+		pending.pConnection = pConnection;
+		QueryFrame::decode(&in[used + 4], length, pending.request);
+		pending.arrived = now;
+		arrived.push_back(pending);
+		connection.inFlight++;
+		used += 4 + length;
+	}
+	in.erase(in.begin(), in.begin() + used);
+	return true;
+}
+
+// ----------------------------------------------------------------
+//  Name:           service
+//  Description:    One turn of the poll loop for a connection: reads
+//                  if poll said so, queues what requests fit and sends
+//                  what answers the socket will take.
+//  Arguments:      The connection, what poll returned for it, the time
+//                  and the list to add requests to.
+//  Return Value:   false once the connection is to be dropped: it
+//                  failed, sent garbage, or was shut by the client and
+//                  has nothing left in flight or to send.
+// ----------------------------------------------------------------
+bool service(shared_ptr<Connection> const & pConnection, short events, Clock::time_point now, vector<Pending>& arrived)
+{
+	Connection& connection = *pConnection;
+	if (connection.broken)
+	{
+		return false;
+	}
+	if (connection.reading && (events & (POLLIN | POLLHUP | POLLERR)) != 0 && !readFrames(connection))
+	{
+		return false;
+	}
+	if (!takeFrames(pConnection, now, arrived) || !connection.flush())
+	{
+		return false;
+	}
+	return connection.reading || connection.inFlight > 0 || connection.unsent() > 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		cerr << "usage: aStar_Server <nodes file> <arcs file> <socket> [threads] [batch]" << endl;
+		return 2;
+	}
+	int threads = (argc > 4) ? atoi(argv[4]) : (int)thread::hardware_concurrency();
+	threads = max(threads, 1);
+	size_t maxBatch = (argc > 5) ? (size_t)max(atoi(argv[5]), 1) : 64;
+	string socketPath = argv[3];
+	string statsPath = socketPath + ".stats";
+
+	Clock::time_point begin = Clock::now();
+	QueryGraph graph(0);
+	if (!loadGraph(argv[1], argv[2], graph, threads))
+	{
+		cerr << "cannot read " << argv[1] << " or " << argv[2] << endl;
+		return 1;
+	}
+	cerr << "loaded " << graph.nodeCount() << " nodes and " << graph.arcCount() << " arcs in "
+		<< chrono::duration_cast<chrono::milliseconds>(Clock::now() - begin).count() << " ms" << endl;
+
+	int listener = listenOn(socketPath);
+	int statsListener = listenOn(statsPath);
+	if (listener < 0 || statsListener < 0)
+	{
+		cerr << "cannot listen on " << socketPath << " or " << statsPath << ": " << strerror(errno) << endl;
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, onStop);
+	signal(SIGTERM, onStop);
+
+	Stats stats;
+	RequestQueue queue;
+	Waker waker;
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(thread([&]()
+		{
+			work(graph, queue, stats, maxBatch, (size_t)threads, waker);
+		}));
+	}
+	cerr << "serving on " << socketPath << " with " << threads << " threads" << endl;
+
+	vector<shared_ptr<Connection> > connections;
+	vector<pollfd> polled;
+	vector<Pending> arrived;
+	while (!stopping)
+	{
+		polled.clear();
+		pollfd listening = { listener, POLLIN, 0 };
+		pollfd statsListening = { statsListener, POLLIN, 0 };
+		pollfd waking = { waker.fd(), POLLIN, 0 };
+		polled.push_back(listening);
+		polled.push_back(statsListening);
+		polled.push_back(waking);
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			// a connection over its limits is not read, and one with
+			// nothing to do is left out; a negative fd is skipped.
+			Connection& connection = *connections[i];
+			size_t unsent = connection.unsent();
+			short events = 0;
+			if (connection.reading && connection.inFlight < maxInFlight && unsent < maxUnsent)
+			{
+				events |= POLLIN;
+			}
+			if (unsent > 0)
+			{
+				events |= POLLOUT;
+			}
+			pollfd client = { (events != 0) ? connection.socket : -1, events, 0 };
+			polled.push_back(client);
+		}
+		// wake now and then to notice a stop signal.
+		if (::poll(&polled[0], polled.size(), 200) < 0)
+		{
+			continue;
+		}
+		if ((polled[2].revents & POLLIN) != 0)
+		{
+			waker.drain();
+		}
+
+		// every connection gets a turn, as answers arriving can let one
+		// take more of its buffered requests or close.
+		Clock::time_point now = Clock::now();
+		size_t kept = 0;
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			if (service(connections[i], polled[i + 3].revents, now, arrived))
+			{
+				connections[kept++] = connections[i];
+			}
+			else
+			{
+				connections[i]->broken = true;
+				stats.connections--;
+			}
+		}
+		connections.resize(kept);
+		queue.push(arrived);
+
+		if ((polled[0].revents & POLLIN) != 0)
+		{
+			int client = ::accept(listener, 0, 0);
+			if (client >= 0)
+			{
+				::fcntl(client, F_SETFL, O_NONBLOCK);
+				connections.push_back(make_shared<Connection>(client));
+				stats.connections++;
+			}
+		}
+		if ((polled[1].revents & POLLIN) != 0)
+		{
+			int client = ::accept(statsListener, 0, 0);
+			if (client >= 0)
+			{
+				string report = stats.report(queue.size());
+				::send(client, report.data(), report.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+				::close(client);
+			}
+		}
+	}
+
+	queue.stop();
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+	connections.clear();
+	::close(listener);
+	::close(statsListener);
+	::unlink(socketPath.c_str());
+	::unlink(statsPath.c_str());
+	cerr << stats.report(0);
+	return 0;
+}
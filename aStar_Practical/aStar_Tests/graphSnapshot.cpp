@@ -0,0 +1,281 @@
+// ----------------------------------------------------------------
+//  Checks VersionedGraph under load: reader threads search the
+//  latest snapshot while the main thread edits the graph and
+//  publishes after every edit. Each reader's versions must never go
+//  backwards, and every aStar result must be a real path in its
+//  snapshot at the cost a plain uniform cost search of that same
+//  snapshot finds. Built with -fsanitize=thread (see main.cpp) it
+//  also checks that readers and the editor never race.
+//  Run from main.cpp.
+// ----------------------------------------------------------------
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Graph.h"
+#include "GraphSnapshot.h"
+
+using namespace std;
+
+typedef Graph<string, int> TestGraph;
+typedef GraphSnapshot<string, int> Snapshot;
+
+static int const side = 20;
+static int const readers = 4;
+static int const publishes = 2000;
+
+static mutex failureMutex;
+static int failures = 0;
+
+static void fail(Snapshot const & snapshot, NodeId start, NodeId goal, string const & what)
+{
+	lock_guard<mutex> lock(failureMutex);
+	cout << "version " << snapshot.version() << " " << start << " -> " << goal << ": " << what << endl;
+	failures++;
+}
+
+// The same sequence on every platform, unlike rand().
+static unsigned int nextRandom(unsigned int& seed)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) & 0x7fff;
+}
+
+// ----------------------------------------------------------------
+//  Name:           ucsCost
+//  Description:    The cheapest cost from start to goal in a snapshot,
+//                  found without an estimate, to check aStar against.
+//  Arguments:      The snapshot, the start and the goal.
+//  Return Value:   The cost, or -1 if the goal cannot be reached.
+// ----------------------------------------------------------------
+static int ucsCost(Snapshot const & snapshot, NodeId start, NodeId goal)
+{
+	typedef pair<int, NodeId> Entry;
+	vector<int> cost(snapshot.nodeCount(), numeric_limits<int>::max());
+	priority_queue<Entry, vector<Entry>, greater<Entry> > open;
+	cost[start] = 0;
+	open.push(Entry(0, start));
+	while (!open.empty())
+	{
+		Entry top = open.top();
+		open.pop();
+		if (top.first != cost[top.second])
+		{
+			continue;
+		}
+		if (top.second == goal)
+		{
+			return top.first;
+		}
+		vector<Snapshot::OutArc> const & arcs = snapshot.node(top.second).arcs;
+		for (size_t i = 0; i < arcs.size(); i++)
+		{
+			int dist = top.first + arcs[i].second;
+			if (dist < cost[arcs[i].first])
+			{
+				cost[arcs[i].first] = dist;
+				open.push(Entry(dist, arcs[i].first));
+			}
+		}
+	}
+	return -1;
+}
+
+// The cost of a goal first path in a snapshot, or -1 if a step is
+// not an arc.
+static int pathCost(Snapshot const & snapshot, vector<NodeId> const & path)
+{
+	int cost = 0;
+	for (size_t i = path.size() - 1; i > 0; i--)
+	{
+		int cheapest = -1;
+		vector<Snapshot::OutArc> const & arcs = snapshot.node(path[i]).arcs;
+		for (size_t arc = 0; arc < arcs.size(); arc++)
+		{
+			if (arcs[arc].first == path[i - 1] && (cheapest < 0 || arcs[arc].second < cheapest))
+			{
+				cheapest = arcs[arc].second;
+			}
+		}
+		if (cheapest < 0)
+		{
+			return -1;
+		}
+		cost += cheapest;
+	}
+	return cost;
+}
+
+// ----------------------------------------------------------------
+//  Name:           readVersions
+//  Description:    One reader thread: searches whatever version is
+//                  current until the editor is done, checking each
+//                  result against its own snapshot.
+//  Arguments:      The graph, the flag the editor sets when it is
+//                  done, the seed and a count of queries to add to.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+static void readVersions(VersionedGraph<string, int> const & versions, atomic<bool> const & done,
+	unsigned int seed, atomic<int>& queries)
+{
+	IndexedSearchSpace<int> space;
+	unsigned long long lastVersion = 0;
+	while (!done.load())
+	{
+		shared_ptr<Snapshot const> pSnapshot = versions.acquire();
+		Snapshot const & snapshot = *pSnapshot;
+		if (snapshot.version() < lastVersion)
+		{
+			fail(snapshot, 0, 0, "went back to an older version");
+		}
+		lastVersion = snapshot.version();
+
+		NodeId start = nextRandom(seed) % snapshot.nodeCount();
+		NodeId goal = nextRandom(seed) % snapshot.nodeCount();
+		if (!snapshot.node(start).present || !snapshot.node(goal).present)
+		{
+			continue;
+		}
+		vector<NodeId> path;
+		bool found = snapshot.aStar(start, goal, space, path);
+		int cost = ucsCost(snapshot, start, goal);
+		if (found != (cost >= 0))
+		{
+			fail(snapshot, start, goal, found ? "found a path to an unreachable goal" : "missed a path");
+		}
+		else if (found && (path.front() != goal || path.back() != start || pathCost(snapshot, path) != cost))
+		{
+			ostringstream what;
+			what << "returned a path costing " << pathCost(snapshot, path) << " instead of " << cost;
+			fail(snapshot, start, goal, what.str());
+		}
+		queries++;
+	}
+}
+
+// Adds the arcs between a node and its grid neighbours that are
+// present, both ways.
+static void linkNode(TestGraph& graph, int node, unsigned int& seed)
+{
+	int x = node % side;
+	int y = node / side;
+	int neighbours[] = { x > 0 ? node - 1 : -1, x + 1 < side ? node + 1 : -1,
+		y > 0 ? node - side : -1, y + 1 < side ? node + side : -1 };
+	for (int i = 0; i < 4; i++)
+	{
+		if (neighbours[i] >= 0 && graph.nodeArray()[neighbours[i]] != 0)
+		{
+			graph.addArc(node, neighbours[i], 10 + nextRandom(seed) % 20);
+			graph.addArc(neighbours[i], node, 10 + nextRandom(seed) % 20);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           testSnapshotStress
+//  Description:    A grid edited and published many times while the
+//                  readers search it. Most passes change or remove one
+//                  arc; every fiftieth removes a node and adds it
+//                  back with new arcs.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+static void testSnapshotStress()
+{
+	TestGraph graph(side * side);
+	unsigned int seed = 11;
+	for (int node = 0; node < side * side; node++)
+	{
+		graph.addNode("n", GraphPosition((node % side) * 10.0f, (node / side) * 10.0f), node);
+	}
+	for (int node = 0; node < side * side; node++)
+	{
+		int x = node % side;
+		if (x + 1 < side)
+		{
+			graph.addArc(node, node + 1, 10 + nextRandom(seed) % 20);
+			graph.addArc(node + 1, node, 10 + nextRandom(seed) % 20);
+		}
+		if (node + side < side * side)
+		{
+			graph.addArc(node, node + side, 10 + nextRandom(seed) % 20);
+			graph.addArc(node + side, node, 10 + nextRandom(seed) % 20);
+		}
+	}
+
+	VersionedGraph<string, int> versions(graph);
+	atomic<bool> done(false);
+	atomic<int> queries(0);
+	vector<thread> threads;
+	for (int i = 0; i < readers; i++)
+	{
+		threads.push_back(thread(readVersions, cref(versions), cref(done), 100u + i, ref(queries)));
+	}
+
+	// every pass makes at least one edit, so every publish is a new
+	// version.
+	for (int i = 0; i < publishes; i++)
+	{
+		int node = (nextRandom(seed) % side) * side + nextRandom(seed) % (side - 1);
+		if (i % 50 == 49)
+		{
+			graph.removeNode(node);
+			graph.addNode("n", GraphPosition((node % side) * 10.0f, (node / side) * 10.0f), node);
+			linkNode(graph, node, seed);
+		}
+		else if (graph.getArc(node, node + 1) == 0)
+		{
+			graph.addArc(node, node + 1, 10 + nextRandom(seed) % 20);
+		}
+		else
+		{
+			// a new weight, or now and then no arc at all.
+			graph.removeArc(node, node + 1);
+			if (nextRandom(seed) % 4 != 0)
+			{
+				graph.addArc(node, node + 1, 10 + nextRandom(seed) % 20);
+			}
+		}
+		versions.publish();
+	}
+
+	done.store(true);
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	if (versions.acquire()->version() != (unsigned long long)publishes)
+	{
+		lock_guard<mutex> lock(failureMutex);
+		cout << "published " << versions.acquire()->version() << " versions instead of " << publishes << endl;
+		failures++;
+	}
+	if (queries.load() == 0)
+	{
+		lock_guard<mutex> lock(failureMutex);
+		cout << "the readers never got to search" << endl;
+		failures++;
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           graphSnapshotTests
+//  Description:    Runs the tests in this file.
+//  Arguments:      None.
+//  Return Value:   The number of failures.
+// ----------------------------------------------------------------
+int graphSnapshotTests()
+{
+	testSnapshotStress();
+	return failures;
+}
@@ -0,0 +1,27 @@
+// ----------------------------------------------------------------
+//  aStar_Tests: runs every test in this folder. Each test prints
+//  its mismatches and the program exits with 1 if there were any.
+//      g++ -std=c++11 -O2 -pthread -I../aStar_Practical *.cpp -o aStar_Tests
+//  The snapshot test is meant to be run under ThreadSanitizer too:
+//      g++ -std=c++11 -O1 -g -fsanitize=thread -pthread -I../aStar_Practical *.cpp -o aStar_Tests
+// ----------------------------------------------------------------
+
+#include <iostream>
+
+using namespace std;
+
+int memoryBoundedSearchTests();
+int graphSnapshotTests();
+
+int main()
+{
+	int failures = memoryBoundedSearchTests();
+	failures += graphSnapshotTests();
+	if (failures > 0)
+	{
+		cout << failures << " failures" << endl;
+		return 1;
+	}
+	cout << "all passed" << endl;
+	return 0;
+}
@@ -0,0 +1,207 @@
+// ----------------------------------------------------------------
+//  Checks MemoryBoundedSearch against ucs. Every path idaStar and
+//  smaStar return must be a real path at the cheapest cost, a
+//  failure on a reachable goal must come with gaveUp(), and an
+//  unreachable goal must fail within the expansion limit.
+//  Run from main.cpp.
+// ----------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "IndexedGraph.h"
+#include "MemoryBoundedSearch.h"
+
+using namespace std;
+
+typedef IndexedGraph<string, int> TestGraph;
+
+static int failures = 0;
+
+static void fail(string const & search, NodeId start, NodeId goal, string const & what)
+{
+	cout << search << " " << start << " -> " << goal << ": " << what << endl;
+	failures++;
+}
+
+// The same sequence on every platform, unlike rand().
+static unsigned int nextRandom(unsigned int& seed)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) & 0x7fff;
+}
+
+// ----------------------------------------------------------------
+//  Name:           makeGrid
+//  Description:    A side by side grid with random weights of at
+//                  least the distance between neighbours, a tenth of
+//                  the nodes without arcs of their own and some one
+//                  way streets. The last column has no arcs in or out,
+//                  so goals there are unreachable.
+//  Arguments:      The side length and the graph to fill.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+static void makeGrid(int side, TestGraph& graph)
+{
+	unsigned int seed = 3;
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			graph.setNode(y * side + x, "n", GraphPosition(x * 10.0f, y * 10.0f));
+		}
+	}
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side - 1; x++)
+		{
+			NodeId node = y * side + x;
+			if (nextRandom(seed) % 10 == 0)
+			{
+				continue;
+			}
+			if (x + 2 < side)
+			{
+				graph.addArc(node, node + 1, 10 + nextRandom(seed) % 20);
+				graph.addArc(node + 1, node, 10 + nextRandom(seed) % 20);
+			}
+			if (y + 1 < side)
+			{
+				graph.addArc(node, node + side, 10 + nextRandom(seed) % 20);
+				if (nextRandom(seed) % 4 != 0)
+				{
+					graph.addArc(node + side, node, 10 + nextRandom(seed) % 20);
+				}
+			}
+		}
+	}
+	graph.finalise();
+}
+
+// The cost of a goal first path, or -1 if a step is not an arc.
+static int pathCost(TestGraph const & graph, vector<NodeId> const & path)
+{
+	int cost = 0;
+	for (size_t i = path.size() - 1; i > 0; i--)
+	{
+		int cheapest = -1;
+		for (unsigned int arc = graph.firstArc(path[i]); arc < graph.firstArc(path[i] + 1); arc++)
+		{
+			if (graph.arcTarget(arc) == path[i - 1] && (cheapest < 0 || graph.arcWeight(arc) < cheapest))
+			{
+				cheapest = graph.arcWeight(arc);
+			}
+		}
+		if (cheapest < 0)
+		{
+			return -1;
+		}
+		cost += cheapest;
+	}
+	return cost;
+}
+
+static void check(TestGraph const & graph, MemoryBoundedSearch<string, int>& search, bool ida,
+	NodeId start, NodeId goal, bool reachable, int cost)
+{
+	string name = ida ? "idaStar" : "smaStar";
+	vector<NodeId> path;
+	bool found = ida ? search.idaStar(start, goal, path) : search.smaStar(start, goal, path);
+	if (found)
+	{
+		if (!reachable)
+		{
+			fail(name, start, goal, "found a path to an unreachable goal");
+		}
+		else if (path.empty() || path.front() != goal || path.back() != start || pathCost(graph, path) != search.cost())
+		{
+			fail(name, start, goal, "returned a path that does not match its cost");
+		}
+		else if (search.cost() != cost)
+		{
+			fail(name, start, goal, "returned a path that is not the cheapest");
+		}
+	}
+	else if (reachable && !search.gaveUp())
+	{
+		fail(name, start, goal, "missed a path without giving up");
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           testGrid
+//  Description:    Random queries on a grid at several budgets, from
+//                  one that cannot hold most paths to one that holds
+//                  them easily.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+static void testGrid()
+{
+	int const side = 40;
+	TestGraph graph(side * side);
+	makeGrid(side, graph);
+	IndexedSearchSpace<int> space;
+	size_t budgets[] = { 2000, 20000, 400000 };
+	for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++)
+	{
+		MemoryBoundedSearch<string, int> search(graph, budgets[b], 100000);
+		unsigned int seed = 7;
+		for (int q = 0; q < 40; q++)
+		{
+			NodeId start = nextRandom(seed) % graph.nodeCount();
+			NodeId goal = nextRandom(seed) % graph.nodeCount();
+			vector<NodeId> path;
+			bool reachable = graph.ucs(start, goal, space, path);
+			int cost = reachable ? space.costDist(goal) : 0;
+			check(graph, search, true, start, goal, reachable, cost);
+			check(graph, search, false, start, goal, reachable, cost);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           testLongCheapPath
+//  Description:    A cheap path of many steps beside a dear one arc
+//                  shortcut. With too little budget to hold the cheap
+//                  path neither search may return the shortcut.
+//  Arguments:      None.
+//  Return Value:   None.
+// ----------------------------------------------------------------
+static void testLongCheapPath()
+{
+	int const steps = 60;
+	TestGraph graph(steps + 1);
+	for (int i = 0; i <= steps; i++)
+	{
+		graph.setNode(i, "n", GraphPosition(0.0f, 0.0f));
+	}
+	for (int i = 0; i < steps; i++)
+	{
+		graph.addArc(i, i + 1, 1);
+	}
+	graph.addArc(0, steps, 1000);
+	graph.finalise();
+
+	size_t budgets[] = { 500, 100000 };
+	for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++)
+	{
+		MemoryBoundedSearch<string, int> search(graph, budgets[b], 100000);
+		check(graph, search, true, 0, steps, true, steps);
+		check(graph, search, false, 0, steps, true, steps);
+	}
+}
+
+// ----------------------------------------------------------------
+//  Name:           memoryBoundedSearchTests
+//  Description:    Runs the tests in this file.
+//  Arguments:      None.
+//  Return Value:   The number of failures.
+// ----------------------------------------------------------------
+int memoryBoundedSearchTests()
+{
+	testGrid();
+	testLongCheapPath();
+	return failures;
+}